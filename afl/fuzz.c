@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <stddef.h>
+#include <unistd.h>
+
+#include "../sqlite2mdoc.h"
+
+/*
+ * AFL++ persistent-mode harness.
+ * Each input is parsed, post-processed, and rendered in all output
+ * types into a sink that discards it, all in-process.
+ * Built with afl-clang-fast (or afl-clang-lto), this uses shared-memory
+ * test cases; otherwise, it runs once over standard input, which is
+ * useful for reproducing crashes.
+ */
+
+#ifndef __AFL_FUZZ_TESTCASE_LEN
+static	unsigned char fuzz_buf[1024 * 1024];
+static	ssize_t fuzz_len;
+static	int fuzz_done;
+# define __AFL_FUZZ_INIT()	/* nothing */
+# define __AFL_INIT()		/* nothing */
+# define __AFL_FUZZ_TESTCASE_BUF fuzz_buf
+# define __AFL_FUZZ_TESTCASE_LEN fuzz_len
+# define __AFL_LOOP(_n)		(!fuzz_done++ && \
+	(fuzz_len = read(STDIN_FILENO, fuzz_buf, sizeof(fuzz_buf))) >= 0)
+#endif
+
+__AFL_FUZZ_INIT();
+
+static int
+sink(void *arg, const char *buf, size_t sz)
+{
+	volatile size_t	*total = arg;
+
+	*total += sz;
+	return 1;
+}
+
+int
+main(void)
+{
+	struct sqlite2mdoc		*s;
+	const struct sqlite2mdoc_page	*pg;
+	const unsigned char		*buf;
+	size_t				 len, total = 0;
+	enum sqlite2mdoc_type		 type;
+
+	__AFL_INIT();
+	buf = __AFL_FUZZ_TESTCASE_BUF;
+
+	while (__AFL_LOOP(10000)) {
+		len = __AFL_FUZZ_TESTCASE_LEN;
+		s = sqlite2mdoc_parse("<fuzz>",
+			(const char *)buf, len, 0);
+		if (s == NULL)
+			continue;
+		sqlite2mdoc_postprocess(s, SQLITE2MDOC_MDOC);
+		for (pg = sqlite2mdoc_first(s); pg != NULL;
+		     pg = sqlite2mdoc_next(pg))
+			for (type = 0; type < SQLITE2MDOC__MAX; type++)
+				sqlite2mdoc_render(s, pg, type, sink, &total);
+		sqlite2mdoc_free(s);
+	}
+
+	return 0;
+}
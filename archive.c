@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extern.h"
+
+/*
+ * Size of a ustar block.
+ * Headers occupy one block and file contents are padded to a multiple
+ * of it.
+ */
+#define	TAR_BLOCKSZ	512
+
+/*
+ * The POSIX ustar header.
+ * All numeric fields are NUL-terminated octal strings.
+ */
+struct	tarhdr {
+	char	 name[100];
+	char	 mode[8];
+	char	 uid[8];
+	char	 gid[8];
+	char	 size[12];
+	char	 mtime[12];
+	char	 chksum[8];
+	char	 typeflag;
+	char	 linkname[100];
+	char	 magic[6];
+	char	 version[2];
+	char	 uname[32];
+	char	 gname[32];
+	char	 devmajor[8];
+	char	 devminor[8];
+	char	 prefix[155];
+	char	 pad[12];
+};
+
+/*
+ * Modification time stamped on all archive members.
+ * To keep the output reproducible, this is never the current time: it's
+ * SOURCE_DATE_EPOCH if set (and sane), otherwise zero.
+ */
+static long long
+archive_mtime(void)
+{
+	const char	*cp;
+	char		*ep;
+	long long	 v;
+
+	if ((cp = getenv("SOURCE_DATE_EPOCH")) == NULL || *cp == '\0')
+		return 0;
+	v = strtoll(cp, &ep, 10);
+	if (*ep != '\0' || v < 0 || v > 077777777777LL)
+		return 0;
+	return v;
+}
+
+/*
+ * Write a single regular file "name" with the given contents as a
+ * ustar archive member.
+ * Returns zero on failure (name too long or write error), non-zero on
+ * success.
+ */
+int
+archive_write(FILE *f, const char *name, const struct buf *b)
+{
+	struct tarhdr	 hdr;
+	const unsigned char *cp;
+	static const char pad[TAR_BLOCKSZ];
+	size_t		 i, sum, sz;
+
+	if ((sz = strlen(name)) >= sizeof(hdr.name)) {
+		warnx("%s: name too long for archive", name);
+		return 0;
+	}
+
+	memset(&hdr, 0, sizeof(struct tarhdr));
+	memcpy(hdr.name, name, sz);
+	snprintf(hdr.mode, sizeof(hdr.mode), "%07o", 0644);
+	snprintf(hdr.uid, sizeof(hdr.uid), "%07o", 0);
+	snprintf(hdr.gid, sizeof(hdr.gid), "%07o", 0);
+	snprintf(hdr.size, sizeof(hdr.size), "%011zo", b->sz);
+	snprintf(hdr.mtime, sizeof(hdr.mtime), "%011llo",
+		archive_mtime());
+	hdr.typeflag = '0';
+	memcpy(hdr.magic, "ustar", 6);
+	memcpy(hdr.version, "00", 2);
+	strlcpy(hdr.uname, "root", sizeof(hdr.uname));
+	strlcpy(hdr.gname, "wheel", sizeof(hdr.gname));
+
+	/* Checksum is computed with the checksum field as spaces. */
+
+	memset(hdr.chksum, ' ', sizeof(hdr.chksum));
+	cp = (const unsigned char *)&hdr;
+	for (sum = i = 0; i < sizeof(struct tarhdr); i++)
+		sum += cp[i];
+	snprintf(hdr.chksum, sizeof(hdr.chksum), "%06zo", sum);
+	hdr.chksum[7] = ' ';
+
+	if (fwrite(&hdr, sizeof(struct tarhdr), 1, f) != 1)
+		goto out;
+	if (b->sz > 0 && fwrite(b->data, b->sz, 1, f) != 1)
+		goto out;
+	if ((sz = b->sz % TAR_BLOCKSZ) > 0 &&
+	    fwrite(pad, TAR_BLOCKSZ - sz, 1, f) != 1)
+		goto out;
+	return 1;
+out:
+	warn("%s: archive write", name);
+	return 0;
+}
+
+/*
+ * Terminate the archive with two empty blocks and flush it.
+ * Returns zero on failure, non-zero on success.
+ */
+int
+archive_close(FILE *f)
+{
+	static const char pad[TAR_BLOCKSZ * 2];
+
+	if (fwrite(pad, sizeof(pad), 1, f) != 1 || fflush(f) == EOF) {
+		warn("archive write");
+		return 0;
+	}
+	return 1;
+}
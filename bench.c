@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+
+#include <ctype.h>
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "extern.h"
+
+/*
+ * Identifiers that must survive renaming: these are stripped from the
+ * synopsis by name, so renaming them would change what we measure.
+ */
+static const char *const keep[] = {
+	"SQLITE_API",
+	"SQLITE_DEPRECATED",
+	"SQLITE_EXPERIMENTAL",
+	"SQLITE_EXTERN",
+	"SQLITE_STDCALL",
+	NULL
+};
+
+/*
+ * Times (in seconds) and totals of a single benchmark run.
+ */
+struct	bench {
+	double	 parse;
+	double	 post;
+	double	 emit;
+	size_t	 pages; /* definitions parsed */
+	size_t	 outsz; /* bytes rendered */
+};
+
+static double
+now(void)
+{
+	struct timespec	 ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err(1, "clock_gettime");
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Read all of "fn" into "b".
+ */
+static void
+readfile(struct buf *b, const char *fn)
+{
+	FILE	*f;
+	char	 io[BUFSIZ];
+	size_t	 sz;
+
+	if ((f = fopen(fn, "r")) == NULL)
+		err(1, "%s", fn);
+	while ((sz = fread(io, 1, sizeof(io), f)) > 0)
+		buf_write(b, io, sz);
+	if (ferror(f))
+		err(1, "%s", fn);
+	fclose(f);
+}
+
+/*
+ * Copy "sz" bytes of "cp" into "b", renaming all sqlite3_ and SQLITE_
+ * identifiers (except those in keep[]) with the copy number "k".
+ */
+static void
+rename_block(struct buf *b, const char *cp, size_t sz, size_t k)
+{
+	size_t	 i, j, idsz;
+
+	for (i = 0; i < sz; ) {
+		if (i > 0 && (isalnum((unsigned char)cp[i - 1]) ||
+		    cp[i - 1] == '_')) {
+			buf_putc(b, cp[i++]);
+			continue;
+		}
+		if (sz - i > 8 && strncmp(&cp[i], "sqlite3_", 8) == 0) {
+			buf_printf(b, "sqlite3_x%zu_", k);
+			i += 8;
+			continue;
+		}
+		if (sz - i <= 7 || strncmp(&cp[i], "SQLITE_", 7)) {
+			buf_putc(b, cp[i++]);
+			continue;
+		}
+		for (idsz = 7; i + idsz < sz; idsz++)
+			if (!isalnum((unsigned char)cp[i + idsz]) &&
+			    cp[i + idsz] != '_')
+				break;
+		for (j = 0; keep[j] != NULL; j++)
+			if (strlen(keep[j]) == idsz &&
+			    strncmp(keep[j], &cp[i], idsz) == 0)
+				break;
+		if (keep[j] != NULL) {
+			buf_write(b, &cp[i], idsz);
+			i += idsz;
+		} else {
+			buf_printf(b, "SQLITE_X%zu_", k);
+			i += 7;
+		}
+	}
+}
+
+/*
+ * Build a synthetic header from "in" with its CAPI3REF blocks (that
+ * is, everything from the comment opening the first one) repeated
+ * "scale" times.  The first copy is verbatim, the rest are renamed so
+ * that each copy documents its own interfaces.
+ */
+static void
+synth(struct buf *out, const struct buf *in, size_t scale)
+{
+	const char	*cp;
+	size_t		 k, off;
+
+	cp = memmem(in->data, in->sz, "\n/*\n** CAPI3REF:", 16);
+	if (cp == NULL)
+		errx(1, "no CAPI3REF blocks in input");
+	off = cp - in->data + 1;
+
+	buf_write(out, in->data, in->sz);
+	for (k = 1; k < scale; k++)
+		rename_block(out, in->data + off, in->sz - off, k);
+}
+
+/*
+ * Run the parser over "in", then post-process and render all pages as
+ * mdoc(7) into memory.  Nothing is written out.
+ */
+static void
+run(struct bench *r, const char *fn, const struct buf *in)
+{
+	struct parse	 p;
+	struct defn	*d;
+	struct buf	 ob;
+	char		*data, *cp, *end;
+	double		 t;
+
+	memset(r, 0, sizeof(struct bench));
+	memset(&ob, 0, sizeof(struct buf));
+
+	if ((data = malloc(in->sz + 1)) == NULL)
+		err(1, NULL);
+	memcpy(data, in->data, in->sz);
+	data[in->sz] = '\0';
+
+	parse_init(&p, fn);
+
+	t = now();
+	for (cp = data; *cp != '\0'; cp = end + 1) {
+		p.ln++;
+		if ((end = strchr(cp, '\n')) == NULL)
+			break;
+		*end = '\0';
+		parse_line(&p, cp, end - cp);
+	}
+	r->parse = now() - t;
+
+	if (!parse_finish(&p))
+		errx(1, "%s: parse failed", fn);
+	r->pages += p.defsz;
+
+	t = now();
+	for (d = p.defs; d < p.defs + p.defsz; d++)
+		parse_postprocess(d, ".3");
+	xref_order(p.defs, p.defsz);
+	r->post = now() - t;
+
+	t = now();
+	for (d = p.defs; d < p.defs + p.defsz; d++) {
+		buf_reset(&ob);
+		print_mdoc(&ob, d, 0);
+		r->outsz += ob.sz;
+	}
+	r->emit = now() - t;
+
+	parse_free(&p);
+	buf_free(&ob);
+	free(data);
+}
+
+static void
+report(const char *fn, size_t scale, size_t insz, const struct bench *r)
+{
+	double	 mb = insz / (1024.0 * 1024.0),
+		 total = r->parse + r->post + r->emit;
+
+	printf("%-28s %5zux %8.2f MB %8zu pages\n",
+		fn, scale, mb, r->pages);
+	printf("  %-12s %9.3f s %9.2f MB/s %12.0f pages/s\n",
+		"parse", r->parse, mb / r->parse, r->pages / r->parse);
+	printf("  %-12s %9.3f s %9.2f MB/s %12.0f pages/s\n",
+		"postprocess", r->post, mb / r->post, r->pages / r->post);
+	printf("  %-12s %9.3f s %9.2f MB/s %12.0f pages/s\n",
+		"emit", r->emit, r->outsz / (1024.0 * 1024.0) / r->emit,
+		r->pages / r->emit);
+	printf("  %-12s %9.3f s %9.2f MB/s %12.0f pages/s\n",
+		"total", total, mb / total, r->pages / total);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct buf	 in, syn;
+	struct bench	 r;
+	size_t		 scales[32], nscales = 0, i;
+	char		*cp, *ep, *sv;
+	unsigned long	 v;
+	int		 ch;
+
+	memset(&in, 0, sizeof(struct buf));
+	memset(&syn, 0, sizeof(struct buf));
+
+	while ((ch = getopt(argc, argv, "s:")) != -1)
+		switch (ch) {
+		case 's':
+			if ((sv = strdup(optarg)) == NULL)
+				err(1, NULL);
+			for (cp = strtok(sv, ", "); cp != NULL;
+			     cp = strtok(NULL, ", ")) {
+				v = strtoul(cp, &ep, 10);
+				if (*ep != '\0' || v == 0)
+					errx(1, "%s: bad scale", cp);
+				if (nscales == sizeof(scales) / sizeof(scales[0]))
+					errx(1, "too many scales");
+				scales[nscales++] = v;
+			}
+			free(sv);
+			break;
+		default:
+			goto usage;
+		}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc == 0)
+		goto usage;
+	if (nscales == 0)
+		scales[nscales++] = 1;
+
+	for (; argc > 0; argc--, argv++) {
+		buf_reset(&in);
+		readfile(&in, argv[0]);
+		for (i = 0; i < nscales; i++) {
+			buf_reset(&syn);
+			synth(&syn, &in, scales[i]);
+			run(&r, argv[0], &syn);
+			report(argv[0], scales[i], syn.sz, &r);
+		}
+	}
+
+	buf_free(&in);
+	buf_free(&syn);
+	return 0;
+usage:
+	fprintf(stderr, "usage: %s [-s scale,...] file ...\n",
+		getprogname());
+	return 1;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extern.h"
+
+/*
+ * Make sure that there's room for "sz" more bytes and the trailing NUL
+ * terminator.  Grows geometrically so that appending character by
+ * character isn't quadratic.
+ */
+static void
+buf_grow(struct buf *b, size_t sz)
+{
+	size_t	 nsz;
+	void	*pp;
+
+	if (b->sz + sz + 1 <= b->maxsz)
+		return;
+	nsz = b->maxsz == 0 ? 1024 : b->maxsz;
+	while (nsz < b->sz + sz + 1)
+		nsz *= 2;
+	if ((pp = mem_realloc(MEM_RENDER, b->data, nsz)) == NULL)
+		err(1, NULL);
+	b->data = pp;
+	b->maxsz = nsz;
+}
+
+void
+buf_write(struct buf *b, const char *cp, size_t sz)
+{
+
+	buf_grow(b, sz);
+	memcpy(b->data + b->sz, cp, sz);
+	b->sz += sz;
+	b->data[b->sz] = '\0';
+}
+
+void
+buf_puts(struct buf *b, const char *cp)
+{
+
+	buf_write(b, cp, strlen(cp));
+}
+
+void
+buf_putc(struct buf *b, char c)
+{
+
+	buf_grow(b, 1);
+	b->data[b->sz++] = c;
+	b->data[b->sz] = '\0';
+}
+
+void
+buf_printf(struct buf *b, const char *fmt, ...)
+{
+	va_list	 ap;
+	int	 sz;
+
+	va_start(ap, fmt);
+	sz = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (sz < 0)
+		err(1, NULL);
+
+	buf_grow(b, (size_t)sz);
+	va_start(ap, fmt);
+	vsnprintf(b->data + b->sz, (size_t)sz + 1, fmt, ap);
+	va_end(ap);
+	b->sz += (size_t)sz;
+}
+
+/*
+ * Empty the buffer contents but keep the memory (and scratch) around
+ * for the next page to be rendered.
+ */
+void
+buf_reset(struct buf *b)
+{
+
+	b->sz = 0;
+	if (b->data != NULL)
+		b->data[0] = '\0';
+}
+
+/*
+ * Return the scratch buffer of "b", emptied, for text that's built up
+ * before going into "b".  It's allocated on first use and thereafter
+ * lives (and is reused) as long as "b" does.
+ */
+struct buf *
+buf_scratch(struct buf *b)
+{
+
+	if (b->scratch == NULL &&
+	    (b->scratch = mem_calloc(MEM_RENDER,
+	     1, sizeof(struct buf))) == NULL)
+		err(1, NULL);
+	buf_reset(b->scratch);
+	return b->scratch;
+}
+
+void
+buf_free(struct buf *b)
+{
+
+	if (b->scratch != NULL) {
+		buf_free(b->scratch);
+		mem_free(b->scratch);
+	}
+	mem_free(b->data);
+	mem_free(b->xrs);
+	memset(b, 0, sizeof(struct buf));
+}
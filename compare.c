@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+
+#include <ctype.h>
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+
+#include "extern.h"
+
+/*
+ * Compare strings (either may be NULL, which is empty) as if all runs
+ * of white-space were a single space and there were none leading or
+ * trailing.
+ * If "paras" is set, runs containing a newline are paragraph breaks
+ * and only match one another.
+ * Returns zero if they're the same.
+ */
+static int
+compare_text(const char *a, const char *b, int paras)
+{
+	int	 first, na, nb;
+
+	if (a == NULL)
+		a = "";
+	if (b == NULL)
+		b = "";
+
+	for (first = 1; ; first = 0) {
+		for (na = 0; isspace((unsigned char)*a); a++)
+			na |= *a == '\n';
+		for (nb = 0; isspace((unsigned char)*b); b++)
+			nb |= *b == '\n';
+		if (*a == '\0' || *b == '\0')
+			return *a != '\0' || *b != '\0';
+		if (paras && !first && na != nb)
+			return 1;
+		while (*a != '\0' && *a == *b &&
+		    !isspace((unsigned char)*a)) {
+			a++;
+			b++;
+		}
+		if ((*a != '\0' && !isspace((unsigned char)*a)) ||
+		    (*b != '\0' && !isspace((unsigned char)*b)))
+			return 1;
+	}
+}
+
+static int
+compare_strs(const char *const *a, size_t asz, const char *const *b,
+	size_t bsz)
+{
+	size_t	 i;
+
+	if (asz != bsz)
+		return 1;
+	for (i = 0; i < asz; i++)
+		if (strcmp(a[i], b[i]))
+			return 1;
+	return 0;
+}
+
+static int
+compare_decls(const struct defn *a, const struct defn *b)
+{
+	size_t	 i;
+
+	if (a->declsz != b->declsz)
+		return 1;
+	for (i = 0; i < a->declsz; i++)
+		if (a->decls[i].type != b->decls[i].type ||
+		    compare_text(a->decls[i].text, b->decls[i].text, 0))
+			return 1;
+	return 0;
+}
+
+/*
+ * References resolve within each definition's own parse, so compare
+ * the names of the pages they resolve to.
+ */
+static int
+compare_xrefs(const struct defn *a, const struct defn *b)
+{
+	struct buf		  ba, bb;
+	const struct defn	**xa, **xb;
+	size_t			  i, asz, bsz;
+	int			  rc;
+
+	memset(&ba, 0, sizeof(struct buf));
+	memset(&bb, 0, sizeof(struct buf));
+	asz = xref_resolve(&ba, a, 0, &xa);
+	bsz = xref_resolve(&bb, b, 0, &xb);
+	rc = asz != bsz;
+	for (i = 0; rc == 0 && i < asz; i++)
+		rc = strcmp(xa[i]->nms[0], xb[i]->nms[0]) != 0;
+	buf_free(&ba);
+	buf_free(&bb);
+	return rc;
+}
+
+/*
+ * Like compare_xrefs(), but for the pages referring to each, which are
+ * only filled in when both parses have been inverted.
+ */
+static int
+compare_rxrefs(const struct defn *a, const struct defn *b)
+{
+	size_t	 i;
+
+	if (a->rxsz != b->rxsz)
+		return 1;
+	for (i = 0; i < a->rxsz; i++)
+		if (strcmp(a->rxs[i]->nms[0], b->rxs[i]->nms[0]))
+			return 1;
+	return 0;
+}
+
+/*
+ * Whether two post-processed definitions, usually of the same name in
+ * different versions of a header, would produce different pages.
+ * Where they are in their input is ignored, as is white-space in the
+ * description (other than paragraph breaks) and declarations (both
+ * parsed and raw).
+ * Returns zero if they're the same.
+ */
+int
+compare_defn(const struct defn *a, const struct defn *b)
+{
+
+	return compare_text(a->name, b->name, 0) ||
+		strcmp(a->dt, b->dt) ||
+		compare_strs(a->nms, a->nmsz, b->nms, b->nmsz) ||
+		compare_strs(a->keys, a->keysz, b->keys, b->keysz) ||
+		compare_text(a->desc, b->desc, 1) ||
+		compare_decls(a, b) ||
+		compare_text(a->fulldesc, b->fulldesc, 0) ||
+		compare_xrefs(a, b) ||
+		compare_rxrefs(a, b);
+}
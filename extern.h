@@ -36,8 +36,53 @@ enum	decltype {
 	DECLTYPE_NEITHER /* non-preprocessor, no semicolon */
 };
 
-TAILQ_HEAD(defnq, defn);
-TAILQ_HEAD(declq, decl);
+/*
+ * Type of document to produce for each definition.
+ */
+enum	outtype {
+	OUTTYPE_MDOC, /* mdoc(7) manpage */
+	OUTTYPE_HTML, /* HTML5 document */
+	OUTTYPE_MARKDOWN, /* Markdown document */
+	OUTTYPE_JSON, /* JSON array of all documents */
+	OUTTYPE_JSONL, /* JSON object per line per document */
+	OUTTYPE__MAX
+};
+
+/*
+ * HTML tags recognised in descriptions.
+ */
+enum	tag {
+	TAG_A,
+	TAG_B,
+	TAG_BLOCK,
+	TAG_BR,
+	TAG_DD,
+	TAG_DL,
+	TAG_DT,
+	TAG_EM,
+	TAG_H3,
+	TAG_I,
+	TAG_LI,
+	TAG_OL,
+	TAG_P,
+	TAG_PRE,
+	TAG_SPAN,
+	TAG_TABLE,
+	TAG_TD,
+	TAG_TH,
+	TAG_TR,
+	TAG_U,
+	TAG_UL,
+	TAG__MAX,
+};
+
+/*
+ * HTML attributes of recognised tags that we care about.
+ */
+enum	attr {
+	ATTR_HREF,
+	ATTR__MAX,
+};
 
 /*
  * A declaration of type DECLTYPE_CPP or DECLTYPE_C.
@@ -47,7 +92,50 @@ struct	decl {
 	enum decltype	 type; /* type of declaration */
 	char		*text; /* text */
 	size_t		 textsz; /* strlen(text) */
-	TAILQ_ENTRY(decl) entries;
+};
+
+/*
+ * A slot in the keyword table.
+ */
+struct	keyent {
+	const char	  *key; /* keyword or NULL if empty */
+	unsigned int	   hash; /* hash of key */
+	const struct defn *d; /* definition of key */
+};
+
+struct	keytri;
+
+/*
+ * A slot in the string table.
+ */
+struct	strent {
+	const char	*str; /* string or NULL if empty */
+	unsigned int	 hash; /* hash of str */
+};
+
+/*
+ * Table of distinct strings, which are stored in chunks.
+ * It's empty if zeroed.
+ */
+struct	strtab {
+	struct strent	*ents; /* slots */
+	size_t		 sz; /* number of slots */
+	size_t		 len; /* number of strings */
+	char		**chunks; /* storage */
+	size_t		 chunksz; /* number of chunks */
+	char		*next; /* free space in last chunk */
+	size_t		 left; /* bytes at "next" */
+};
+
+/*
+ * Table mapping keywords (and names) to their definitions.
+ * It's empty if zeroed.
+ */
+struct	keytab {
+	struct keyent	*ents; /* slots */
+	size_t		 sz; /* number of slots */
+	size_t		 len; /* number of keys */
+	struct keytri	*tri; /* trigrams for suggestions or NULL */
 };
 
 /*
@@ -55,43 +143,243 @@ struct	decl {
  */
 struct	defn {
 	char		 *name; /* really Nd */
-	TAILQ_ENTRY(defn) entries;
 	char		 *desc; /* long description */
 	size_t		  descsz; /* strlen(desc) */
 	char		 *fulldesc; /* description w/newlns */
 	size_t		  fulldescsz; /* strlen(fulldesc) */
-	struct declq	  dcqhead; /* declarations */
+	struct decl	 *decls; /* declarations in order */
+	size_t		  declsz; /* number of declarations */
+	size_t		  declmax; /* declarations allocated */
 	int		  multiline; /* used when parsing */
 	int		  instruct; /* used when parsing */
 	const char	 *fn; /* parsed from file */
 	size_t		  ln; /* parsed at line */
 	int		  postprocessed; /* good for emission? */
 	char		 *dt; /* manpage title */
-	char		**nms; /* manpage names */
+	const char	**nms; /* manpage names (interned) */
 	size_t		  nmsz; /* number of names */
 	char		 *fname; /* manpage filename */
 	char		 *keybuf; /* raw keywords */
 	size_t		  keybufsz; /* length of "keysbuf" */
 	char		 *seealso; /* see also tags */
 	size_t		  seealsosz; /* length of seealso */
-	char		**xrs; /* parsed "see also" references */
+	const char	**xrs; /* parsed references (interned) */
 	size_t		  xrsz; /* number of references */
-	char		**keys; /* parsed keywords */
+	const char	**keys; /* parsed keywords (interned) */
 	size_t		  keysz; /* number of keywords */
+	struct keytab	 *keytab; /* keywords of the parse */
+	struct strtab	 *strtab; /* strings of the parse */
+	const char	 *filter; /* pattern of pages to keep or NULL */
+	int		  filtered; /* not matching filter */
+	const struct defn **rxs; /* pages referring to us or NULL */
+	size_t		  rxsz; /* number of referring pages */
+	size_t		  ord; /* order by name from 1 or 0 if unset */
+};
+
+/*
+ * Growable output buffer into which a manpage is rendered before being
+ * written out in one piece.
+ * Each renderer owns one and resets it between pages, so both it and
+ * its scratch grow to the largest page and are then reused as-is.
+ * The data is always NUL-terminated.
+ */
+struct	buf {
+	char		*data; /* contents or NULL */
+	size_t		 sz; /* bytes used (w/o NUL) */
+	size_t		 maxsz; /* bytes allocated */
+	struct buf	*scratch; /* see buf_scratch() or NULL */
+	const struct defn **xrs; /* scratch for xref_resolve() */
+	size_t		 xrmax; /* slots allocated in "xrs" */
 };
 
 /*
  * Entire parse routine.
+ * Definitions are stored contiguously, so pointers to them are only
+ * taken once parsing is done, and are followed by a zeroed one (with a
+ * NULL name) so that they may be iterated without the parse.
  */
 struct	parse {
 	enum phase	 phase; /* phase of parse */
 	size_t		 ln; /* line number */
 	const char	*fn; /* open file */
-	struct defnq	 dqhead; /* definitions */
+	struct defn	*defs; /* definitions in input order */
+	size_t		 defsz; /* number of definitions */
+	size_t		 defmax; /* definitions allocated */
+	int		 verbose; /* show parse warnings */
+	struct keytab	 keys; /* keywords of all definitions */
+	struct strtab	 strs; /* names, keywords, and references */
+	const char	*filter; /* pattern of pages to keep or NULL */
+	char		*desc; /* description pending filter or NULL */
+	size_t		 descsz; /* strlen(desc) */
+	size_t		 descmax; /* bytes allocated for desc */
 };
 
-void	print_description(FILE *, const struct defn *);
-void	print_implementation(FILE *, const struct defn *, int);
-void	print_synopsis(FILE *, const struct decl *, const struct defn *);
+/*
+ * Input kept in memory for watch mode, split into blocks that are
+ * parsed independently.
+ */
+struct	watch {
+	const char	*fn; /* input file */
+	const char	*suffix; /* filename suffix */
+	int		 verbose; /* show parse warnings */
+	const char	*filter; /* pattern of pages to keep or NULL */
+	struct keytab	 keys; /* keywords of all blocks */
+	struct wblock	*bs; /* blocks in input order */
+	size_t		 bsz; /* number of blocks */
+	int		 fd; /* inotify(7) descriptor or -1 */
+	long long	 mtime; /* input modification time (polling) */
+	long long	 size; /* input size (polling) */
+	unsigned long long ino; /* input inode (polling) */
+};
+
+/*
+ * Stages of processing timed by the statistics.
+ */
+enum	stage {
+	STAGE_PARSE, /* reading and parsing input */
+	STAGE_POSTPROCESS, /* post-processing definitions */
+	STAGE_RENDER, /* rendering pages into memory */
+	STAGE_WRITE, /* writing pages out */
+	STAGE__MAX
+};
+
+/*
+ * Subsystems charged for allocations made through mem_*().
+ */
+enum	memsys {
+	MEM_PARSE, /* the parsed model */
+	MEM_POSTPROCESS, /* names, keys, references */
+	MEM_RENDER, /* output buffers and scratch */
+	MEM__MAX
+};
+
+/*
+ * Allocation counters for a single subsystem.
+ */
+struct	memstat {
+	size_t		 allocs; /* allocations */
+	size_t		 reallocs; /* reallocations */
+	size_t		 frees; /* frees */
+	size_t		 live; /* bytes currently allocated */
+	size_t		 peak; /* maximum of live */
+};
+
+/*
+ * Wall and CPU time, in seconds.
+ */
+struct	stats_time {
+	double		 wall;
+	double		 cpu;
+};
+
+/*
+ * Statistics collected if requested.
+ */
+struct	stats {
+	struct stats_time stages[STAGE__MAX]; /* time per stage */
+	double		 wall; /* start of current stage */
+	double		 cpu; /* start of current stage */
+	size_t		 lines; /* lines read */
+	size_t		 defns; /* definitions parsed */
+	size_t		 decls; /* declarations parsed */
+	size_t		 descsz; /* bytes of description */
+	size_t		 hinserts; /* keyword table inserts */
+	size_t		 hlookups; /* keyword table lookups */
+	size_t		 hmisses; /* failed lookups */
+	size_t		 pages; /* pages written */
+	size_t		 outsz; /* bytes written */
+	struct memstat	 mem[MEM__MAX]; /* allocations */
+};
+
+extern struct stats *stats;
+
+int	archive_close(FILE *);
+int	archive_write(FILE *, const char *, const struct buf *);
+
+void	buf_free(struct buf *);
+void	buf_printf(struct buf *, const char *, ...)
+		__attribute__((format(printf, 2, 3)));
+void	buf_putc(struct buf *, char);
+void	buf_puts(struct buf *, const char *);
+void	buf_reset(struct buf *);
+struct buf *buf_scratch(struct buf *);
+void	buf_write(struct buf *, const char *, size_t);
+
+extern const char *const tagnames[TAG__MAX];
+
+enum tag parse_tags(const char *, size_t *, const char **,
+		size_t *, int *);
+
+int	 compare_defn(const struct defn *, const struct defn *);
+
+int	 index_search(char *const *, size_t, const char *,
+		const char *);
+int	 index_query(const char *, const char *, const char *, int,
+		void (*)(const struct defn *));
+int	 index_write(FILE *, FILE *, const char *, const struct parse *,
+		const char *);
+
+void	 strtab_free(struct strtab *);
+const char *strtab_intern(struct strtab *, const char *, size_t);
+
+void	 keytab_free(struct keytab *);
+const struct defn *keytab_find(const struct keytab *, const char *);
+void	 keytab_insert(struct keytab *, const char *, const struct defn *);
+size_t	 keytab_suggest(struct keytab *, const char *, const char **,
+		size_t);
+
+const struct defn *xref_lookup(const struct keytab *, const char *);
+void	 xref_invert(struct defn *, size_t);
+void	 xref_order(struct defn *, size_t);
+size_t	 xref_resolve(struct buf *, const struct defn *, int,
+		const struct defn ***);
+size_t	 xref_token(struct buf *, const struct defn *, size_t,
+		const char **, size_t *, int *, const struct defn **);
+
+void	 parse_buf(struct parse *, const char *, size_t);
+int	 parse_finish(struct parse *);
+void	 parse_free(struct parse *);
+void	 parse_init(struct parse *, const char *);
+void	 parse_move(struct parse *, struct parse *);
+void	 parse_line(struct parse *, const char *, size_t);
+void	 parse_postprocess(struct defn *, const char *);
+
+int	 server_run(const char *, char *[], size_t, int);
+
+void	 watch_free(struct watch *);
+void	 watch_init(struct watch *, const char *, const char *, int);
+size_t	 watch_update(struct watch *, const char *, size_t,
+		void (*)(const struct defn *), void (*)(const char *));
+int	 watch_start(struct watch *);
+int	 watch_wait(struct watch *);
+
+int	 mem_asprintf(enum memsys, char **, const char *, ...)
+		__attribute__((format(printf, 3, 4)));
+void	*mem_calloc(enum memsys, size_t, size_t);
+void	 mem_free(void *);
+void	*mem_malloc(enum memsys, size_t);
+void	*mem_realloc(enum memsys, void *, size_t);
+void	*mem_reallocarray(enum memsys, void *, size_t, size_t);
+char	*mem_strdup(enum memsys, const char *);
+char	*mem_strndup(enum memsys, const char *, size_t);
+
+void	 stats_begin(void);
+void	 stats_end(enum stage);
+void	 stats_parse(const struct parse *);
+void	 stats_print(FILE *, int);
+
+size_t	 synopsis_offs(const struct decl *);
+void	 synopsis_text(struct buf *, const struct decl *);
+
+void	print_description(struct buf *, const struct defn *);
+void	print_html(struct buf *, const struct defn *, int);
+void	json_string(struct buf *, const char *, size_t);
+
+void	print_json(struct buf *, const struct defn *, int);
+void	print_mdoc(struct buf *, const struct defn *, int);
+void	print_markdown(struct buf *, const struct defn *, int);
+void	print_implementation(struct buf *, const struct defn *, int);
+void	print_synopsis(struct buf *, const struct decl *,
+		const struct defn *);
 
 #endif /*!EXTERN_H*/
@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Generate a synthetic header following the SYNTAX in sqlite2mdoc(1).
+ * The output depends only on the arguments: given the same seed and
+ * shape, the same header is always produced.
+ */
+
+#define	COLS	72 /* wrap description lines here */
+
+/*
+ * Shape of the generated header.
+ */
+struct	shape {
+	size_t	 blocks; /* CAPI3REF blocks */
+	size_t	 words; /* description words per block */
+	size_t	 html; /* percentage of words with markup */
+	size_t	 keys; /* keywords per block */
+	size_t	 tables; /* tables per block */
+	size_t	 xrefs; /* references per block */
+};
+
+/*
+ * Output state of a single comment line.
+ */
+struct	gen {
+	uint64_t rng; /* splitmix64 state */
+	size_t	 col; /* current column or zero if at start */
+};
+
+static const char *const words[] = {
+	"the", "database", "connection", "statement", "is", "returned",
+	"when", "a", "value", "of", "if", "and", "or", "not", "may", "be",
+	"called", "application", "interface", "memory", "allocation",
+	"must", "this", "routine", "an", "error", "code", "result", "to",
+	"column", "row", "table", "prepared", "handle", "object", "with",
+	"pointer", "string", "UTF-8", "text", "blob", "integer", "in",
+	"any", "thread", "mutex", "transaction", "journal", "page",
+	"cache", "file", "lock", "schema", "index", "query", "on",
+	NULL
+};
+
+static const char *const inlines[] = { "b", "i", "u", "em", NULL };
+
+/*
+ * A small, portable PRNG so that the output doesn't depend on the
+ * system's random(3).
+ */
+static uint64_t
+next(struct gen *g)
+{
+	uint64_t	 z;
+
+	z = (g->rng += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static size_t
+pick(struct gen *g, size_t n)
+{
+
+	return n == 0 ? 0 : next(g) % n;
+}
+
+/*
+ * Write a token to the comment, wrapping lines at COLS.
+ * Tokens are never split, even if longer than a line.
+ */
+static void
+tok(struct gen *g, const char *cp)
+{
+	size_t	 sz = strlen(cp);
+
+	if (g->col > 0 && g->col + 1 + sz > COLS) {
+		putchar('\n');
+		g->col = 0;
+	}
+	if (g->col == 0) {
+		fputs("**", stdout);
+		g->col = 2;
+	}
+	putchar(' ');
+	fputs(cp, stdout);
+	g->col += 1 + sz;
+}
+
+/*
+ * Append punctuation to the last token, if any.
+ */
+static void
+punct(struct gen *g, char c)
+{
+
+	if (g->col == 0)
+		return;
+	putchar(c);
+	g->col++;
+}
+
+/*
+ * End the current line (if any) and emit an empty comment line, which
+ * is a paragraph break.
+ */
+static void
+par(struct gen *g)
+{
+
+	if (g->col > 0)
+		putchar('\n');
+	puts("**");
+	g->col = 0;
+}
+
+static void
+word(struct gen *g, const struct shape *s)
+{
+	char		 buf[64];
+	const char	*w, *t;
+	size_t		 n;
+
+	for (n = 0; words[n] != NULL; n++)
+		continue;
+	w = words[pick(g, n)];
+
+	if (pick(g, 100) >= s->html) {
+		tok(g, w);
+		return;
+	}
+	for (n = 0; inlines[n] != NULL; n++)
+		continue;
+	t = inlines[pick(g, n)];
+	snprintf(buf, sizeof(buf), "<%s>%s</%s>", t, w, t);
+	tok(g, buf);
+}
+
+/*
+ * Reference either the function or the keyword of another block.
+ */
+static void
+xref(struct gen *g, const struct shape *s, size_t self)
+{
+	char	 buf[128];
+	size_t	 i;
+
+	i = pick(g, s->blocks);
+	if (i == self)
+		i = (i + 1) % s->blocks;
+
+	if (s->keys > 0 && pick(g, 2))
+		snprintf(buf, sizeof(buf), "[sqlite3_gen%zu_kw%zu |"
+			" keyword %zu]", i, pick(g, s->keys), i);
+	else
+		snprintf(buf, sizeof(buf), "[sqlite3_gen%zu()]", i);
+	tok(g, buf);
+}
+
+static void
+table(struct gen *g, const struct shape *s)
+{
+	size_t	 rows, cols, i, j;
+
+	rows = 2 + pick(g, 4);
+	cols = 2 + pick(g, 2);
+
+	par(g);
+	tok(g, "<table border=\"1\">");
+	for (i = 0; i < rows; i++) {
+		par(g);
+		tok(g, "<tr>");
+		for (j = 0; j < cols; j++) {
+			tok(g, i == 0 ? "<th>" : "<td>");
+			word(g, s);
+			word(g, s);
+		}
+	}
+	par(g);
+	tok(g, "</table>");
+	par(g);
+}
+
+static void
+list(struct gen *g, const struct shape *s)
+{
+	size_t	 items, words, i, j;
+
+	items = 2 + pick(g, 4);
+
+	par(g);
+	tok(g, "<ul>");
+	for (i = 0; i < items; i++) {
+		tok(g, "<li>");
+		words = 3 + pick(g, 8);
+		for (j = 0; j < words; j++)
+			word(g, s);
+		tok(g, "</li>");
+	}
+	tok(g, "</ul>");
+	par(g);
+}
+
+static void
+block(struct gen *g, const struct shape *s, size_t i)
+{
+	char	 buf[128];
+	size_t	 j, k, nxrefs, ntables, pos;
+
+	puts("/*");
+	printf("** CAPI3REF: Synthetic Interface %zu\n", i);
+
+	if (s->keys > 0) {
+		printf("** KEYWORDS: {synthetic interface %zu}", i);
+		for (j = 0; j < s->keys; j++)
+			printf(" sqlite3_gen%zu_kw%zu", i, j);
+		putchar('\n');
+	}
+	puts("**");
+
+	/*
+	 * Spread tables and references evenly over the words, and
+	 * start lists at random in proportion to the markup.
+	 */
+
+	g->col = 0;
+	nxrefs = ntables = 0;
+	snprintf(buf, sizeof(buf), "sqlite3_gen%zu()", i);
+	tok(g, "The");
+	tok(g, buf);
+	tok(g, "interface");
+
+	for (j = 0; j < s->words; j++) {
+		pos = (j + 1) * s->xrefs / (s->words + 1);
+		for ( ; nxrefs < pos; nxrefs++)
+			xref(g, s, i);
+		pos = (j + 1) * s->tables / (s->words + 1);
+		for ( ; ntables < pos; ntables++)
+			table(g, s);
+		if (pick(g, 3200) < s->html)
+			list(g, s);
+		word(g, s);
+		if (pick(g, 12) == 0)
+			punct(g, j % 5 ? ',' : '.');
+		if (pick(g, 60) == 0)
+			par(g);
+	}
+	for ( ; nxrefs < s->xrefs; nxrefs++)
+		xref(g, s, i);
+	for ( ; ntables < s->tables; ntables++)
+		table(g, s);
+	punct(g, '.');
+	if (g->col > 0)
+		putchar('\n');
+	puts("*/");
+
+	/* Alternate function and constant blocks. */
+
+	printf("SQLITE_API int sqlite3_gen%zu(sqlite3 *db, "
+		"int iArg, const char *zArg);\n", i);
+	if (i % 2 == 1) {
+		k = 1 + pick(g, 4);
+		for (j = 0; j < k; j++)
+			printf("#define SQLITE_GEN%zu_%zu %zu\n", i, j, j);
+	}
+	putchar('\n');
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct shape	 s;
+	struct gen	 g;
+	size_t		 i, *v;
+	uint64_t	 seed = 1;
+	const char	*er;
+	int		 ch;
+
+	memset(&g, 0, sizeof(struct gen));
+	s.blocks = 100;
+	s.words = 200;
+	s.html = 10;
+	s.keys = 2;
+	s.tables = 0;
+	s.xrefs = 4;
+
+	while ((ch = getopt(argc, argv, "b:h:k:S:t:w:x:")) != -1) {
+		switch (ch) {
+		case 'b':
+			v = &s.blocks;
+			break;
+		case 'h':
+			v = &s.html;
+			break;
+		case 'k':
+			v = &s.keys;
+			break;
+		case 'S':
+			seed = strtonum(optarg, 0, LLONG_MAX, &er);
+			if (er != NULL)
+				errx(1, "-S %s: %s", optarg, er);
+			continue;
+		case 't':
+			v = &s.tables;
+			break;
+		case 'w':
+			v = &s.words;
+			break;
+		case 'x':
+			v = &s.xrefs;
+			break;
+		default:
+			goto usage;
+		}
+		*v = strtonum(optarg, 0, 10000000, &er);
+		if (er != NULL)
+			errx(1, "-%c %s: %s", ch, optarg, er);
+	}
+
+	if (optind != argc)
+		goto usage;
+	if (s.blocks == 0)
+		errx(1, "-b: need at least one block");
+	if (s.html > 100)
+		errx(1, "-h: percentage exceeds 100");
+
+	g.rng = seed;
+
+	puts("/*\n** Synthetic header generated by sqlite2mdoc-gen.\n*/");
+	printf("/* blocks=%zu words=%zu html=%zu keys=%zu tables=%zu "
+		"xrefs=%zu seed=%" PRIu64 " */\n\n", s.blocks, s.words,
+		s.html, s.keys, s.tables, s.xrefs, seed);
+
+	for (i = 0; i < s.blocks; i++)
+		block(&g, &s, i);
+
+	if (fflush(stdout) == EOF)
+		err(1, "<stdout>");
+	return 0;
+usage:
+	fprintf(stderr, "usage: %s [-b blocks] [-h html%%] [-k keywords] "
+		"[-S seed] [-t tables] [-w words] [-x xrefs]\n",
+		getprogname());
+	return 1;
+}
@@ -0,0 +1,1007 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "extern.h"
+
+/*
+ * The index maps every keyword and name of a header to the byte range
+ * of the interface description (from its CAPI3REF line to the next)
+ * documenting it, so that a single page may be produced by parsing only
+ * that description.
+ * It also maps the words of each page's names, title, and description to
+ * the pages they're in and where, for searching.
+ * It's in host byte order and is laid out as a header, the blocks, the
+ * keys sorted by strcmp(3), the terms likewise, their postings, the
+ * postings' word positions, and a pool of NUL-terminated strings.
+ */
+
+#define	INDEX_MAGIC	"S2MINDEX"
+#define	INDEX_VERSION	2
+
+/*
+ * Words longer than this aren't indexed.
+ */
+#define	INDEX_WORDMAX	64
+
+/*
+ * Words too common to be worth indexing, sorted for bsearch(3).
+ */
+static	const char *const stopwords[] = {
+	"an", "and", "any", "are", "as", "at", "be", "by", "can", "for",
+	"from", "has", "have", "if", "in", "is", "it", "its", "may", "no",
+	"not", "of", "on", "or", "so", "such", "that", "the", "then",
+	"there", "these", "this", "to", "was", "when", "which", "will",
+	"with",
+};
+
+/*
+ * Words in a page's names and title count this many times more than
+ * those in its description.
+ */
+#define	INDEX_LEADWT	3
+
+struct	idxhead {
+	char		 magic[8]; /* INDEX_MAGIC */
+	uint32_t	 version; /* INDEX_VERSION */
+	uint32_t	 blocksz; /* number of blocks */
+	uint32_t	 keysz; /* number of keys */
+	uint32_t	 strsz; /* bytes of strings */
+	uint64_t	 size; /* header size */
+	int64_t		 mtime; /* header modification time */
+	uint32_t	 path; /* header (absolute) path */
+	uint32_t	 termsz; /* number of terms */
+	uint32_t	 postsz; /* number of postings */
+	uint32_t	 possz; /* number of positions */
+};
+
+struct	idxblock {
+	uint64_t	 off; /* offset in header */
+	uint32_t	 len; /* length in header */
+	uint32_t	 ln; /* line of CAPI3REF */
+	uint32_t	 name; /* primary name */
+	uint32_t	 stem; /* filename less suffix */
+	uint32_t	 title; /* title (Nd) */
+	uint32_t	 words; /* words indexed */
+	uint32_t	 lead; /* words of names and title */
+	uint32_t	 pad;
+};
+
+struct	idxkey {
+	uint32_t	 key; /* keyword or name */
+	uint32_t	 block; /* block documenting it */
+};
+
+struct	idxterm {
+	uint32_t	 term; /* lowercase word */
+	uint32_t	 post; /* first posting */
+	uint32_t	 postsz; /* number of postings */
+};
+
+struct	idxpost {
+	uint32_t	 block; /* block containing term */
+	uint32_t	 pos; /* first position */
+	uint32_t	 possz; /* number of positions */
+};
+
+/*
+ * A mapped index.
+ */
+struct	index {
+	void			*map; /* whole file */
+	size_t			 mapsz; /* size of map */
+	const struct idxhead	*head;
+	const struct idxblock	*blocks;
+	const struct idxkey	*keys;
+	const struct idxterm	*terms;
+	const struct idxpost	*posts;
+	const uint32_t		*poss;
+	const char		*strs;
+};
+
+/*
+ * A page that's the target of a reference, known only by its name (in
+ * the mapped index) and filename from the index.
+ */
+struct	idxstub {
+	struct defn	 d;
+	const char	*nms[1];
+};
+
+/*
+ * Used when building, so that keys may be sorted by their strings.
+ */
+struct	idxsort {
+	const char	*key;
+	uint32_t	 block;
+};
+
+/*
+ * Used when building, one per word in each page.
+ * The word is first an offset into the buffer of words, then (when
+ * that's no longer growing) a pointer into it.
+ */
+struct	idxocc {
+	size_t		 off;
+	const char	*term;
+	uint32_t	 block;
+	uint32_t	 pos;
+};
+
+struct	idxwords {
+	struct buf	 text; /* NUL-terminated words */
+	struct idxocc	*occs;
+	size_t		 occsz;
+	size_t		 occmax;
+};
+
+/*
+ * A page found by searching.
+ */
+struct	idxhit {
+	double		 score;
+	size_t		 order; /* index in argument order */
+	const char	*name;
+	const char	*fname;
+	const char	*title;
+};
+
+static int
+idxsort_cmp(const void *p1, const void *p2)
+{
+
+	return strcmp(((const struct idxsort *)p1)->key,
+		((const struct idxsort *)p2)->key);
+}
+
+static int
+idxocc_cmp(const void *p1, const void *p2)
+{
+	const struct idxocc	*o1 = p1, *o2 = p2;
+	int			 c;
+
+	if ((c = strcmp(o1->term, o2->term)) != 0)
+		return c;
+	if (o1->block != o2->block)
+		return o1->block < o2->block ? -1 : 1;
+	return o1->pos < o2->pos ? -1 : o1->pos > o2->pos;
+}
+
+/*
+ * Order first by filename then by argument order, so that the first
+ * index with a page may be kept.
+ */
+static int
+idxhit_fname_cmp(const void *p1, const void *p2)
+{
+	const struct idxhit	*h1 = p1, *h2 = p2;
+	int			 c;
+
+	if ((c = strcmp(h1->fname, h2->fname)) != 0)
+		return c;
+	return h1->order < h2->order ? -1 : h1->order > h2->order;
+}
+
+/*
+ * Order by descending score, then by name.
+ */
+static int
+idxhit_score_cmp(const void *p1, const void *p2)
+{
+	const struct idxhit	*h1 = p1, *h2 = p2;
+
+	if (h1->score != h2->score)
+		return h1->score > h2->score ? -1 : 1;
+	return strcmp(h1->name, h2->name);
+}
+
+static int
+stopword_cmp(const void *p1, const void *p2)
+{
+
+	return strcmp(p1, *(const char *const *)p2);
+}
+
+/*
+ * Whether "word", lowercase, is too common to index.
+ */
+static int
+index_stopword(const char *word)
+{
+
+	return bsearch(word, stopwords,
+		sizeof(stopwords) / sizeof(stopwords[0]),
+		sizeof(stopwords[0]), stopword_cmp) != NULL;
+}
+
+/*
+ * Copy the next word of "*cp" into "word", lowercase, and advance
+ * "*cp" past it.
+ * Words are runs of letters, digits, and underscores of at least two
+ * and at most INDEX_WORDMAX characters that aren't stop-words.
+ * Returns the word's length or zero if there are no more.
+ */
+static size_t
+index_word(const char **cp, char *word)
+{
+	const char	*start;
+	size_t		 sz;
+
+	for (;;) {
+		while (**cp != '\0' && !isalnum((unsigned char)**cp) &&
+		    **cp != '_')
+			(*cp)++;
+		if (**cp == '\0')
+			return 0;
+		start = *cp;
+		while (isalnum((unsigned char)**cp) || **cp == '_')
+			(*cp)++;
+		if ((sz = *cp - start) < 2 || sz > INDEX_WORDMAX)
+			continue;
+		for (sz = 0; start + sz < *cp; sz++)
+			word[sz] = tolower((unsigned char)start[sz]);
+		word[sz] = '\0';
+		if (!index_stopword(word))
+			return sz;
+	}
+}
+
+/*
+ * Add an occurrence of "word" of length "sz".
+ */
+static void
+index_occ(struct idxwords *w, const char *word, size_t sz,
+	uint32_t block, uint32_t pos)
+{
+	void	*pp;
+
+	if (w->occsz == w->occmax) {
+		pp = mem_reallocarray(MEM_POSTPROCESS, w->occs,
+			w->occmax + 1024, sizeof(struct idxocc));
+		if (pp == NULL)
+			err(1, NULL);
+		w->occs = pp;
+		w->occmax += 1024;
+	}
+	w->occs[w->occsz].off = w->text.sz;
+	w->occs[w->occsz].block = block;
+	w->occs[w->occsz++].pos = pos;
+	buf_write(&w->text, word, sz);
+	buf_putc(&w->text, '\0');
+}
+
+/*
+ * Add the words of "cp" (which may be NULL) in "block", starting at
+ * position "*pos".
+ * Identifiers like "sqlite3_open" also add their parts ("open") at the
+ * same position so that they're found by plain words.
+ */
+static void
+index_text(struct idxwords *w, const char *cp, uint32_t block,
+	uint32_t *pos)
+{
+	char		 word[INDEX_WORDMAX + 1], part[INDEX_WORDMAX + 1];
+	const char	*pcp;
+	size_t		 sz, psz;
+
+	if (cp == NULL)
+		return;
+	while ((sz = index_word(&cp, word)) > 0) {
+		index_occ(w, word, sz, block, *pos);
+		if (strchr(word, '_') != NULL)
+			for (pcp = word; *pcp != '\0'; pcp += psz) {
+				pcp += strspn(pcp, "_");
+				if ((psz = strcspn(pcp, "_")) < 2)
+					continue;
+				memcpy(part, pcp, psz);
+				part[psz] = '\0';
+				if (!index_stopword(part))
+					index_occ(w, part, psz, block, *pos);
+			}
+		(*pos)++;
+	}
+}
+
+/*
+ * A rough base-two logarithm of "x" (at least one) that's monotonic
+ * and so good enough for weighting without needing libm.
+ */
+static double
+index_log(double x)
+{
+	double	 r = 0.0;
+
+	while (x >= 2.0) {
+		x /= 2.0;
+		r += 1.0;
+	}
+	return r + (x - 1.0);
+}
+
+/*
+ * Append a string to the pool, returning its offset.
+ */
+static uint32_t
+index_str(struct buf *b, const char *cp, size_t sz)
+{
+	uint32_t	 off = b->sz;
+
+	buf_write(b, cp, sz);
+	buf_putc(b, '\0');
+	return off;
+}
+
+/*
+ * Write the index of the fully-parsed and post-processed "p" into
+ * "out".
+ * Its input "in", whose absolute name is "path", is read again for the
+ * byte offsets of its descriptions.
+ * Returns zero on failure.
+ */
+int
+index_write(FILE *out, FILE *in, const char *path,
+	const struct parse *p, const char *suffix)
+{
+	struct idxhead		  head;
+	struct idxblock		 *blocks = NULL;
+	struct idxsort		 *keys = NULL;
+	struct idxkey		  k;
+	struct idxterm		 *terms = NULL;
+	struct idxpost		 *posts = NULL;
+	uint32_t		 *poss = NULL, pos;
+	struct idxwords		  w;
+	const struct defn	 *d;
+	struct buf		  strs;
+	struct stat		  st;
+	char			 *line = NULL;
+	const char		 *cp;
+	size_t			  i, n = 0, bufsz = 0, ln = 0, off = 0;
+	size_t			  stemsz, sfxsz = strlen(suffix);
+	ssize_t			  len;
+	int			  rc = 0;
+
+	memset(&head, 0, sizeof(struct idxhead));
+	memset(&strs, 0, sizeof(struct buf));
+	memset(&w, 0, sizeof(struct idxwords));
+
+	if (fstat(fileno(in), &st) == -1 || fseek(in, 0, SEEK_SET) == -1) {
+		warn("%s", p->fn);
+		goto out;
+	}
+
+	memcpy(head.magic, INDEX_MAGIC, sizeof(head.magic));
+	head.version = INDEX_VERSION;
+	head.size = st.st_size;
+	head.mtime = st.st_mtime;
+	buf_putc(&strs, '\0');
+	head.path = index_str(&strs, path, strlen(path));
+
+	head.blocksz = p->defsz;
+	if ((blocks = mem_calloc(MEM_POSTPROCESS,
+	    head.blocksz, sizeof(struct idxblock))) == NULL)
+		err(1, NULL);
+
+	/*
+	 * Each block runs from its CAPI3REF line to that of the next
+	 * block, so find the byte offsets of these lines.
+	 */
+
+	d = p->defs;
+	while (d < p->defs + p->defsz) {
+		if (ln + 1 == d->ln) {
+			blocks[n].off = off;
+			blocks[n].ln = d->ln;
+			if (n > 0)
+				blocks[n - 1].len = off - blocks[n - 1].off;
+			if (d->postprocessed) {
+				blocks[n].name = index_str(&strs,
+					d->nms[0], strlen(d->nms[0]));
+				stemsz = strlen(d->fname) - sfxsz;
+				blocks[n].stem = index_str(&strs,
+					d->fname, stemsz);
+				cp = d->name != NULL ? d->name : "";
+				blocks[n].title = index_str(&strs,
+					cp, strlen(cp));
+			}
+			n++;
+			d++;
+			continue;
+		}
+		if ((len = getline(&line, &bufsz, in)) == -1)
+			break;
+		off += len;
+		ln++;
+	}
+	if (d < p->defs + p->defsz) {
+		warnx("%s: changed while indexing", p->fn);
+		goto out;
+	}
+	if (n > 0)
+		blocks[n - 1].len = st.st_size - blocks[n - 1].off;
+
+	/*
+	 * Keys map to the block of their definition in the keyword
+	 * table, so that the first definition wins as usual.
+	 * Definitions without names can't be referenced.
+	 */
+
+	for (i = n = 0; n < head.blocksz; n++)
+		i += p->defs[n].keysz + p->defs[n].nmsz;
+	if ((keys = mem_calloc(MEM_POSTPROCESS,
+	    i, sizeof(struct idxsort))) == NULL)
+		err(1, NULL);
+	for (n = 0; n < head.blocksz; n++) {
+		d = &p->defs[n];
+		if (!d->postprocessed)
+			continue;
+		for (i = 0; i < d->keysz + d->nmsz; i++) {
+			cp = i < d->keysz ? d->keys[i] :
+				d->nms[i - d->keysz];
+			if (keytab_find(&p->keys, cp) != d)
+				continue;
+			keys[head.keysz].key = cp;
+			keys[head.keysz++].block = n;
+		}
+	}
+	qsort(keys, head.keysz, sizeof(struct idxsort), idxsort_cmp);
+
+	/* A definition may repeat a keyword or use a name as one. */
+
+	for (i = n = 0; i < head.keysz; i++)
+		if (n == 0 || strcmp(keys[n - 1].key, keys[i].key))
+			keys[n++] = keys[i];
+	head.keysz = n;
+
+	/*
+	 * Collect the words of each page, those of its names and title
+	 * (the lead) first, then sort them by word and position.
+	 */
+
+	for (n = 0; n < head.blocksz; n++) {
+		d = &p->defs[n];
+		if (!d->postprocessed)
+			continue;
+		pos = 0;
+		for (i = 0; i < d->nmsz; i++)
+			index_text(&w, d->nms[i], n, &pos);
+		index_text(&w, d->name, n, &pos);
+		blocks[n].lead = pos;
+		index_text(&w, d->desc, n, &pos);
+		blocks[n].words = pos;
+	}
+	for (i = 0; i < w.occsz; i++)
+		w.occs[i].term = w.text.data + w.occs[i].off;
+	qsort(w.occs, w.occsz, sizeof(struct idxocc), idxocc_cmp);
+
+	/* Each term has a posting per page and a position per word. */
+
+	terms = mem_calloc(MEM_POSTPROCESS,
+		w.occsz + 1, sizeof(struct idxterm));
+	posts = mem_calloc(MEM_POSTPROCESS,
+		w.occsz + 1, sizeof(struct idxpost));
+	poss = mem_calloc(MEM_POSTPROCESS,
+		w.occsz + 1, sizeof(uint32_t));
+	if (terms == NULL || posts == NULL || poss == NULL)
+		err(1, NULL);
+	for (i = 0; i < w.occsz; i++) {
+		if (i == 0 || strcmp(w.occs[i - 1].term, w.occs[i].term)) {
+			terms[head.termsz].term = index_str(&strs,
+				w.occs[i].term, strlen(w.occs[i].term));
+			terms[head.termsz++].post = head.postsz;
+		} else if (w.occs[i - 1].block == w.occs[i].block) {
+			poss[head.possz++] = w.occs[i].pos;
+			posts[head.postsz - 1].possz++;
+			continue;
+		}
+		terms[head.termsz - 1].postsz++;
+		posts[head.postsz].block = w.occs[i].block;
+		posts[head.postsz].pos = head.possz;
+		posts[head.postsz++].possz = 1;
+		poss[head.possz++] = w.occs[i].pos;
+	}
+
+	fwrite(&head, sizeof(struct idxhead), 1, out);
+	fwrite(blocks, sizeof(struct idxblock), head.blocksz, out);
+	for (i = 0; i < head.keysz; i++) {
+		k.key = index_str(&strs, keys[i].key, strlen(keys[i].key));
+		k.block = keys[i].block;
+		fwrite(&k, sizeof(struct idxkey), 1, out);
+	}
+	fwrite(terms, sizeof(struct idxterm), head.termsz, out);
+	fwrite(posts, sizeof(struct idxpost), head.postsz, out);
+	fwrite(poss, sizeof(uint32_t), head.possz, out);
+	head.strsz = strs.sz;
+	fwrite(strs.data, 1, strs.sz, out);
+	if (fseek(out, 0, SEEK_SET) == -1 ||
+	    fwrite(&head, sizeof(struct idxhead), 1, out) != 1 ||
+	    fflush(out) == EOF || ferror(out)) {
+		warn("index");
+		goto out;
+	}
+	rc = 1;
+out:
+	free(line);
+	mem_free(blocks);
+	mem_free(keys);
+	mem_free(terms);
+	mem_free(posts);
+	mem_free(poss);
+	mem_free(w.occs);
+	buf_free(&w.text);
+	buf_free(&strs);
+	return rc;
+}
+
+/*
+ * Map and check the index "ifn".
+ * Returns zero on failure.
+ */
+static int
+index_open(struct index *ix, const char *ifn)
+{
+	struct stat	 st;
+	size_t		 sz;
+	int		 fd;
+
+	memset(ix, 0, sizeof(struct index));
+
+	if ((fd = open(ifn, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+		warn("%s", ifn);
+		if (fd != -1)
+			close(fd);
+		return 0;
+	}
+	if ((size_t)st.st_size < sizeof(struct idxhead)) {
+		warnx("%s: not an index", ifn);
+		close(fd);
+		return 0;
+	}
+	ix->mapsz = st.st_size;
+	ix->map = mmap(NULL, ix->mapsz, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (ix->map == MAP_FAILED) {
+		warn("%s: mmap", ifn);
+		ix->map = NULL;
+		return 0;
+	}
+
+	ix->head = ix->map;
+	if (memcmp(ix->head->magic, INDEX_MAGIC, sizeof(ix->head->magic)) ||
+	    ix->head->version != INDEX_VERSION) {
+		warnx("%s: not an index", ifn);
+		return 0;
+	}
+	ix->blocks = (const struct idxblock *)(ix->head + 1);
+	ix->keys = (const struct idxkey *)(ix->blocks + ix->head->blocksz);
+	ix->terms = (const struct idxterm *)(ix->keys + ix->head->keysz);
+	ix->posts = (const struct idxpost *)(ix->terms + ix->head->termsz);
+	ix->poss = (const uint32_t *)(ix->posts + ix->head->postsz);
+	ix->strs = (const char *)(ix->poss + ix->head->possz);
+
+	sz = sizeof(struct idxhead) +
+		(size_t)ix->head->blocksz * sizeof(struct idxblock) +
+		(size_t)ix->head->keysz * sizeof(struct idxkey) +
+		(size_t)ix->head->termsz * sizeof(struct idxterm) +
+		(size_t)ix->head->postsz * sizeof(struct idxpost) +
+		(size_t)ix->head->possz * sizeof(uint32_t) +
+		ix->head->strsz;
+	if (sz != ix->mapsz || ix->head->strsz == 0 ||
+	    ix->strs[ix->head->strsz - 1] != '\0' ||
+	    ix->head->path >= ix->head->strsz) {
+		warnx("%s: corrupt index", ifn);
+		return 0;
+	}
+	return 1;
+}
+
+static void
+index_close(struct index *ix)
+{
+
+	if (ix->map != NULL)
+		munmap(ix->map, ix->mapsz);
+}
+
+/*
+ * Binary search for "key" amongst the sorted keys.
+ * Returns the block documenting it or NULL if not found (or if the
+ * index is corrupt).
+ */
+static const struct idxblock *
+index_find(const struct index *ix, const char *key)
+{
+	size_t			 lo = 0, hi = ix->head->keysz, mid;
+	const struct idxkey	*k;
+	int			 c;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		k = &ix->keys[mid];
+		if (k->key >= ix->head->strsz ||
+		    k->block >= ix->head->blocksz)
+			return NULL;
+		if ((c = strcmp(key, ix->strs + k->key)) == 0) {
+			if (ix->blocks[k->block].name >= ix->head->strsz ||
+			    ix->blocks[k->block].stem >= ix->head->strsz)
+				return NULL;
+			return &ix->blocks[k->block];
+		}
+		if (c < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return NULL;
+}
+
+/*
+ * Produce the page documenting "key" using the index "ifn", parsing
+ * only its description, and pass it to "emit".
+ * References are resolved with the index to stand-in pages that have
+ * only a name and filename, which is all that rendering needs.
+ * Returns zero on failure.
+ */
+int
+index_query(const char *ifn, const char *key, const char *suffix,
+	int verbose, void (*emit)(const struct defn *))
+{
+	struct index		  ix;
+	struct parse		  p;
+	struct stat		  st;
+	struct idxstub		**stubs = NULL, *sb;
+	const struct idxblock	 *bl, *xb;
+	struct defn		 *d;
+	const char		 *path;
+	char			 *buf = NULL;
+	ssize_t			  ssz;
+	size_t			  i;
+	int			  fd = -1, rc = 0;
+
+	parse_init(&p, NULL);
+	if (!index_open(&ix, ifn))
+		goto out;
+	if ((bl = index_find(&ix, key)) == NULL) {
+		warnx("%s: not found", key);
+		goto out;
+	}
+
+	/* Read only the block, if the header hasn't changed. */
+
+	path = ix.strs + ix.head->path;
+	if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+		warn("%s", path);
+		goto out;
+	}
+	if ((uint64_t)st.st_size != ix.head->size ||
+	    (int64_t)st.st_mtime != ix.head->mtime ||
+	    bl->off + bl->len > ix.head->size) {
+		warnx("%s: out of date with %s", ifn, path);
+		goto out;
+	}
+	if ((buf = mem_malloc(MEM_PARSE, bl->len + 1)) == NULL)
+		err(1, NULL);
+	if ((ssz = pread(fd, buf, bl->len, bl->off)) == -1) {
+		warn("%s", path);
+		goto out;
+	} else if ((size_t)ssz != bl->len) {
+		warnx("%s: short read", path);
+		goto out;
+	}
+
+	p.fn = path;
+	p.verbose = verbose;
+	p.ln = bl->ln - 1;
+	parse_buf(&p, buf, bl->len);
+	if (!parse_finish(&p))
+		goto out;
+	if (p.defsz == 0) {
+		warnx("%s: out of date with %s", ifn, path);
+		goto out;
+	}
+	d = p.defs;
+	parse_postprocess(d, suffix);
+
+	/*
+	 * Replace the keywords of the definition with the targets of
+	 * its references, one stand-in per target page.
+	 */
+
+	keytab_free(&p.keys);
+	stubs = mem_calloc(MEM_POSTPROCESS,
+		ix.head->blocksz, sizeof(struct idxstub *));
+	if (stubs == NULL)
+		err(1, NULL);
+	for (i = 0; i < d->xrsz; i++) {
+		if ((xb = index_find(&ix, d->xrs[i])) == NULL)
+			continue;
+		if (xb == bl) {
+			keytab_insert(&p.keys, d->xrs[i], d);
+			continue;
+		}
+		if ((sb = stubs[xb - ix.blocks]) == NULL) {
+			sb = mem_calloc(MEM_POSTPROCESS,
+				1, sizeof(struct idxstub));
+			if (sb == NULL)
+				err(1, NULL);
+			sb->nms[0] = ix.strs + xb->name;
+			if (mem_asprintf(MEM_POSTPROCESS, &sb->d.fname,
+			    "%s%s", ix.strs + xb->stem, suffix) == -1)
+				err(1, NULL);
+			sb->d.nms = sb->nms;
+			sb->d.nmsz = 1;
+			sb->d.postprocessed = 1;
+			stubs[xb - ix.blocks] = sb;
+		}
+		keytab_insert(&p.keys, d->xrs[i], &sb->d);
+	}
+
+	emit(d);
+	rc = 1;
+out:
+	if (stubs != NULL)
+		for (i = 0; i < ix.head->blocksz; i++) {
+			if (stubs[i] == NULL)
+				continue;
+			mem_free(stubs[i]->d.fname);
+			mem_free(stubs[i]);
+		}
+	mem_free(stubs);
+	parse_free(&p);
+	mem_free(buf);
+	if (fd != -1)
+		close(fd);
+	index_close(&ix);
+	return rc;
+}
+
+/*
+ * Binary search for "term" amongst the sorted terms.
+ * Returns NULL if not found or if its postings are corrupt.
+ */
+static const struct idxterm *
+index_term(const struct index *ix, const char *term)
+{
+	size_t			 lo = 0, hi = ix->head->termsz, mid;
+	const struct idxterm	*t;
+	int			 c;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		t = &ix->terms[mid];
+		if (t->term >= ix->head->strsz)
+			return NULL;
+		if ((c = strcmp(term, ix->strs + t->term)) == 0)
+			return (uint64_t)t->post + t->postsz >
+				ix->head->postsz ? NULL : t;
+		if (c < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return NULL;
+}
+
+/*
+ * Whether the posting "p" is in bounds of the index and its page.
+ */
+static int
+index_post_valid(const struct index *ix, const struct idxpost *p)
+{
+	const struct idxblock	*bl;
+
+	if (p->block >= ix->head->blocksz ||
+	    (uint64_t)p->pos + p->possz > ix->head->possz)
+		return 0;
+	bl = &ix->blocks[p->block];
+	return bl->name < ix->head->strsz &&
+		bl->stem < ix->head->strsz &&
+		bl->title < ix->head->strsz;
+}
+
+/*
+ * Number of times a position in "a" is followed by one in "b", both
+ * sorted, that is, times their words are adjacent.
+ */
+static size_t
+index_adjacent(const uint32_t *a, size_t asz, const uint32_t *b,
+	size_t bsz)
+{
+	size_t	 i = 0, j = 0, n = 0;
+
+	while (i < asz && j < bsz)
+		if ((uint64_t)a[i] + 1 == b[j]) {
+			n++;
+			i++;
+			j++;
+		} else if ((uint64_t)a[i] + 1 < b[j])
+			i++;
+		else
+			j++;
+	return n;
+}
+
+/*
+ * Score the pages of "ix" for "words" into "scores" using BM25, adding
+ * to that the number of times consecutive words are adjacent.
+ */
+static void
+index_score(const struct index *ix, char *const *words, size_t wordsz,
+	double *scores)
+{
+	const struct idxterm	*t, *pt = NULL;
+	const struct idxpost	*p, *pp;
+	const uint32_t		*poss;
+	double			 n, avgdl = 0.0, idf, pidf = 0.0, tf, dl;
+	size_t			 i, j, k, lead, adj;
+	const double		 k1 = 1.2, b = 0.75;
+
+	if ((n = ix->head->blocksz) == 0)
+		return;
+	for (i = 0; i < ix->head->blocksz; i++)
+		avgdl += ix->blocks[i].words;
+	if ((avgdl /= n) == 0.0)
+		return;
+
+	for (i = 0; i < wordsz; i++, pt = t, pidf = idf) {
+		idf = 0.0;
+		if ((t = index_term(ix, words[i])) == NULL)
+			continue;
+		idf = index_log(1.0 +
+			(n - t->postsz + 0.5) / (t->postsz + 0.5));
+		for (j = 0; j < t->postsz; j++) {
+			p = &ix->posts[t->post + j];
+			if (!index_post_valid(ix, p))
+				continue;
+			poss = &ix->poss[p->pos];
+			for (lead = k = 0; k < p->possz; k++)
+				if (poss[k] < ix->blocks[p->block].lead)
+					lead++;
+			tf = p->possz + (INDEX_LEADWT - 1) * lead;
+			dl = ix->blocks[p->block].words;
+			scores[p->block] += idf * tf * (k1 + 1.0) /
+				(tf + k1 * (1.0 - b + b * dl / avgdl));
+		}
+		if (pt == NULL)
+			continue;
+
+		/* Both posting lists are sorted by page. */
+
+		for (j = k = 0; j < pt->postsz && k < t->postsz; ) {
+			pp = &ix->posts[pt->post + j];
+			p = &ix->posts[t->post + k];
+			if (pp->block < p->block) {
+				j++;
+				continue;
+			} else if (pp->block > p->block) {
+				k++;
+				continue;
+			}
+			if (index_post_valid(ix, pp) &&
+			    index_post_valid(ix, p)) {
+				adj = index_adjacent(&ix->poss[pp->pos],
+					pp->possz, &ix->poss[p->pos], p->possz);
+				scores[p->block] += (pidf + idf) *
+					adj / (adj + 1.0);
+			}
+			j++;
+			k++;
+		}
+	}
+}
+
+/*
+ * Search the indices "ifns" for pages with the words of "query" and
+ * print their names, filenames, and titles to stdout, best first.
+ * A page in several indices (by filename) is taken from the first.
+ * Returns zero on failure or if nothing was found.
+ */
+int
+index_search(char *const *ifns, size_t ifnsz, const char *query,
+	const char *suffix)
+{
+	struct index		*ixs = NULL;
+	struct idxhit		*hits = NULL;
+	const struct idxblock	*bl;
+	char			 word[INDEX_WORDMAX + 1];
+	char			**words = NULL;
+	double			*scores = NULL;
+	const char		*cp = query;
+	size_t			 i, j, n, wordsz = 0, hitsz = 0;
+	void			*pp;
+	int			 rc = 0;
+
+	words = mem_calloc(MEM_PARSE,
+		strlen(query) / 2 + 1, sizeof(char *));
+	if (words == NULL)
+		err(1, NULL);
+	while (index_word(&cp, word) > 0)
+		if ((words[wordsz++] = mem_strdup(MEM_PARSE, word)) == NULL)
+			err(1, NULL);
+	if (wordsz == 0) {
+		warnx("%s: no words to search for", query);
+		goto out;
+	}
+
+	if ((ixs = mem_calloc(MEM_PARSE,
+	    ifnsz, sizeof(struct index))) == NULL)
+		err(1, NULL);
+	for (i = 0; i < ifnsz; i++) {
+		if (!index_open(&ixs[i], ifns[i]))
+			goto out;
+		n = ixs[i].head->blocksz;
+		scores = mem_calloc(MEM_PARSE, n + 1, sizeof(double));
+		pp = mem_reallocarray(MEM_PARSE, hits,
+			hitsz + n + 1, sizeof(struct idxhit));
+		if (scores == NULL || pp == NULL)
+			err(1, NULL);
+		hits = pp;
+		index_score(&ixs[i], words, wordsz, scores);
+		for (j = 0; j < n; j++) {
+			if (scores[j] == 0.0)
+				continue;
+			bl = &ixs[i].blocks[j];
+			hits[hitsz].score = scores[j];
+			hits[hitsz].order = i;
+			hits[hitsz].name = ixs[i].strs + bl->name;
+			hits[hitsz].fname = ixs[i].strs + bl->stem;
+			hits[hitsz++].title = ixs[i].strs + bl->title;
+		}
+		mem_free(scores);
+		scores = NULL;
+	}
+
+	qsort(hits, hitsz, sizeof(struct idxhit), idxhit_fname_cmp);
+	for (i = n = 0; i < hitsz; i++)
+		if (n == 0 || strcmp(hits[n - 1].fname, hits[i].fname))
+			hits[n++] = hits[i];
+	hitsz = n;
+	qsort(hits, hitsz, sizeof(struct idxhit), idxhit_score_cmp);
+
+	for (i = 0; i < hitsz; i++)
+		printf("%s\t%s%s\t%s\n", hits[i].name,
+			hits[i].fname, suffix, hits[i].title);
+	if (hitsz == 0)
+		warnx("%s: nothing appropriate", query);
+	rc = hitsz > 0;
+out:
+	if (ixs != NULL)
+		for (i = 0; i < ifnsz; i++)
+			index_close(&ixs[i]);
+	for (i = 0; i < wordsz; i++)
+		mem_free(words[i]);
+	mem_free(words);
+	mem_free(scores);
+	mem_free(hits);
+	mem_free(ixs);
+	return rc;
+}
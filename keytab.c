@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extern.h"
+
+/*
+ * The keyword table maps keywords and names to the definitions that
+ * document them.
+ * It's an open-addressed hash table with linear probing, kept at most
+ * half full.
+ * Unlike hsearch(3), there may be any number of them and they may be
+ * freed and reused.
+ */
+
+#define	KEYTAB_MINSZ	1024 /* initial slots (power of two) */
+
+/*
+ * Suggestions must share at least this fraction of their trigrams
+ * with what's being looked up (Jaccard similarity).
+ */
+#define	KEYTRI_MINSIM	0.4
+
+/*
+ * Keys with at most this many bytes are considered for suggestions;
+ * longer ones are truncated.
+ */
+#define	KEYTRI_MAXLEN	128
+
+/*
+ * Trigram index over the keys of a table, built on the first request
+ * for a suggestion and dropped whenever the table changes.
+ * Trigrams are of the lowercase key with start and end markers, so
+ * "abc" has "^ab", "abc", and "bc$", each packed into an integer.
+ * Postings are sorted by trigram then key.
+ */
+struct	tripost {
+	uint32_t	 tri; /* trigram */
+	uint32_t	 key; /* index in keys */
+};
+
+struct	keytri {
+	const char	**keys; /* keys that may be suggested */
+	uint32_t	 *ntris; /* distinct trigrams of each key */
+	uint32_t	 *counts; /* trigrams shared with query */
+	uint32_t	 *touched; /* keys with non-zero counts */
+	size_t		  keysz; /* number of keys */
+	struct tripost	 *posts; /* postings */
+	size_t		  postsz; /* number of postings */
+	size_t		  postmax; /* postings allocated */
+};
+
+static void	 keytri_free(struct keytab *);
+
+/*
+ * FNV-1a.
+ * All keywords share prefixes ("sqlite3_", "SQLITE_"), so the hash
+ * must depend on every byte.
+ */
+static unsigned int
+keytab_hash(const char *key)
+{
+	unsigned int	 h = 2166136261U;
+
+	for ( ; *key != '\0'; key++) {
+		h ^= (unsigned char)*key;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static void
+keytab_grow(struct keytab *t)
+{
+	struct keyent	*ents;
+	size_t		 i, j, sz;
+
+	sz = t->sz == 0 ? KEYTAB_MINSZ : t->sz * 2;
+	if ((ents = mem_calloc(MEM_POSTPROCESS,
+	    sz, sizeof(struct keyent))) == NULL)
+		err(1, NULL);
+
+	for (i = 0; i < t->sz; i++) {
+		if (t->ents[i].key == NULL)
+			continue;
+		j = t->ents[i].hash & (sz - 1);
+		while (ents[j].key != NULL)
+			j = (j + 1) & (sz - 1);
+		ents[j] = t->ents[i];
+	}
+
+	mem_free(t->ents);
+	t->ents = ents;
+	t->sz = sz;
+}
+
+/*
+ * Map "key" to "d".
+ * The key is not copied, so it must outlive the table.
+ * Keys are usually interned, so they're first compared by pointer.
+ * Like hsearch(3), an existing mapping is left as-is.
+ */
+void
+keytab_insert(struct keytab *t, const char *key, const struct defn *d)
+{
+	unsigned int	 h;
+	size_t		 i;
+
+	keytri_free(t);
+	if ((t->len + 1) * 2 > t->sz)
+		keytab_grow(t);
+
+	h = keytab_hash(key);
+	for (i = h & (t->sz - 1); t->ents[i].key != NULL;
+	     i = (i + 1) & (t->sz - 1))
+		if (t->ents[i].key == key || (t->ents[i].hash == h &&
+		    strcmp(t->ents[i].key, key) == 0))
+			return;
+
+	t->ents[i].key = key;
+	t->ents[i].hash = h;
+	t->ents[i].d = d;
+	t->len++;
+}
+
+/*
+ * Look up the definition of "key".
+ * Returns the definition or NULL if not found.
+ */
+const struct defn *
+keytab_find(const struct keytab *t, const char *key)
+{
+	unsigned int	 h;
+	size_t		 i;
+
+	if (t->sz == 0)
+		return NULL;
+
+	h = keytab_hash(key);
+	for (i = h & (t->sz - 1); t->ents[i].key != NULL;
+	     i = (i + 1) & (t->sz - 1))
+		if (t->ents[i].key == key || (t->ents[i].hash == h &&
+		    strcmp(t->ents[i].key, key) == 0))
+			return t->ents[i].d;
+
+	return NULL;
+}
+
+/*
+ * Free the table's slots, leaving it empty and reusable.
+ */
+void
+keytab_free(struct keytab *t)
+{
+
+	keytri_free(t);
+	mem_free(t->ents);
+	memset(t, 0, sizeof(struct keytab));
+}
+
+static int
+tripost_cmp(const void *p1, const void *p2)
+{
+	const struct tripost	*t1 = p1, *t2 = p2;
+
+	if (t1->tri != t2->tri)
+		return t1->tri < t2->tri ? -1 : 1;
+	return t1->key < t2->key ? -1 : t1->key > t2->key;
+}
+
+static int
+tri_cmp(const void *p1, const void *p2)
+{
+	uint32_t	 t1 = *(const uint32_t *)p1,
+			 t2 = *(const uint32_t *)p2;
+
+	return t1 < t2 ? -1 : t1 > t2;
+}
+
+/*
+ * Fill "tris" with the distinct trigrams of "key", sorted.
+ * It must fit KEYTRI_MAXLEN + 2 trigrams.
+ * Returns the number of trigrams.
+ */
+static size_t
+keytri_split(const char *key, uint32_t *tris)
+{
+	unsigned char	 s[KEYTRI_MAXLEN + 3];
+	size_t		 i, j, sz;
+
+	s[0] = 0x01;
+	for (sz = 1; *key != '\0' && sz <= KEYTRI_MAXLEN; key++)
+		s[sz++] = tolower((unsigned char)*key);
+	s[sz++] = 0x02;
+
+	for (i = 0; i + 2 < sz; i++)
+		tris[i] = (uint32_t)s[i] << 16 |
+			(uint32_t)s[i + 1] << 8 | s[i + 2];
+	qsort(tris, i, sizeof(uint32_t), tri_cmp);
+	for (sz = i, i = j = 0; i < sz; i++)
+		if (j == 0 || tris[j - 1] != tris[i])
+			tris[j++] = tris[i];
+	return j;
+}
+
+static void
+keytri_build(struct keytab *t)
+{
+	struct keytri	*kt;
+	uint32_t	 tris[KEYTRI_MAXLEN + 2];
+	size_t		 i, j, n;
+	void		*pp;
+
+	if ((kt = mem_calloc(MEM_POSTPROCESS,
+	    1, sizeof(struct keytri))) == NULL)
+		err(1, NULL);
+	kt->keys = mem_calloc(MEM_POSTPROCESS,
+		t->len + 1, sizeof(char *));
+	kt->ntris = mem_calloc(MEM_POSTPROCESS,
+		t->len + 1, sizeof(uint32_t));
+	kt->counts = mem_calloc(MEM_POSTPROCESS,
+		t->len + 1, sizeof(uint32_t));
+	kt->touched = mem_calloc(MEM_POSTPROCESS,
+		t->len + 1, sizeof(uint32_t));
+	if (kt->keys == NULL || kt->ntris == NULL ||
+	    kt->counts == NULL || kt->touched == NULL)
+		err(1, NULL);
+
+	/* Keys of definitions without names can't be referenced. */
+
+	for (i = 0; i < t->sz; i++) {
+		if (t->ents[i].key == NULL || t->ents[i].d->nmsz == 0)
+			continue;
+		n = keytri_split(t->ents[i].key, tris);
+		if (kt->postsz + n > kt->postmax) {
+			pp = mem_reallocarray(MEM_POSTPROCESS, kt->posts,
+				kt->postmax * 2 + n, sizeof(struct tripost));
+			if (pp == NULL)
+				err(1, NULL);
+			kt->posts = pp;
+			kt->postmax = kt->postmax * 2 + n;
+		}
+		for (j = 0; j < n; j++) {
+			kt->posts[kt->postsz].tri = tris[j];
+			kt->posts[kt->postsz++].key = kt->keysz;
+		}
+		kt->ntris[kt->keysz] = n;
+		kt->keys[kt->keysz++] = t->ents[i].key;
+	}
+	qsort(kt->posts, kt->postsz, sizeof(struct tripost), tripost_cmp);
+	t->tri = kt;
+}
+
+static void
+keytri_free(struct keytab *t)
+{
+
+	if (t->tri == NULL)
+		return;
+	mem_free(t->tri->keys);
+	mem_free(t->tri->ntris);
+	mem_free(t->tri->counts);
+	mem_free(t->tri->touched);
+	mem_free(t->tri->posts);
+	mem_free(t->tri);
+	t->tri = NULL;
+}
+
+/*
+ * Suggest keys in the table like "key", which usually isn't in it, by
+ * the trigrams they share.
+ * Fills up to "ressz" of the most similar into "res", most similar
+ * first.
+ * Returns the number filled in.
+ */
+size_t
+keytab_suggest(struct keytab *t, const char *key, const char **res,
+	size_t ressz)
+{
+	struct keytri		*kt;
+	const struct tripost	*p;
+	uint32_t		 tris[KEYTRI_MAXLEN + 2];
+	double			 sims[8], sim;
+	size_t			 i, j, n, lo, hi, mid, ntouched = 0,
+				 resn = 0;
+	uint32_t		 k;
+
+	if (ressz > sizeof(sims) / sizeof(sims[0]))
+		ressz = sizeof(sims) / sizeof(sims[0]);
+	if (t->len == 0 || ressz == 0)
+		return 0;
+	if (t->tri == NULL)
+		keytri_build(t);
+	kt = t->tri;
+
+	/* Count the trigrams each key shares with ours. */
+
+	n = keytri_split(key, tris);
+	for (i = 0; i < n; i++) {
+		lo = 0;
+		hi = kt->postsz;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (kt->posts[mid].tri < tris[i])
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		for (p = &kt->posts[lo];
+		     p < kt->posts + kt->postsz && p->tri == tris[i]; p++)
+			if (kt->counts[p->key]++ == 0)
+				kt->touched[ntouched++] = p->key;
+	}
+
+	/* Keep the most similar, resetting counts as we go. */
+
+	for (i = 0; i < ntouched; i++) {
+		k = kt->touched[i];
+		sim = (double)kt->counts[k] /
+			(n + kt->ntris[k] - kt->counts[k]);
+		kt->counts[k] = 0;
+		if (sim < KEYTRI_MINSIM)
+			continue;
+		for (j = resn; j > 0 && (sims[j - 1] < sim ||
+		     (sims[j - 1] == sim &&
+		      strcmp(res[j - 1], kt->keys[k]) > 0)); j--)
+			if (j < ressz) {
+				sims[j] = sims[j - 1];
+				res[j] = res[j - 1];
+			}
+		if (j < ressz) {
+			sims[j] = sim;
+			res[j] = kt->keys[k];
+			if (resn < ressz)
+				resn++;
+		}
+	}
+	return resn;
+}
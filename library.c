@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extern.h"
+#include "sqlite2mdoc.h"
+
+/*
+ * A parsed header.
+ * Pages are simply definitions.
+ */
+struct	sqlite2mdoc {
+	struct parse	 p; /* parse and definitions */
+	struct buf	 ob; /* scratch for rendering */
+	char		*fn; /* copy of filename */
+	int		 postprocessed; /* postprocess called */
+};
+
+/* Filename suffix for each output type. */
+static	const char *const suffixes[SQLITE2MDOC__MAX] = {
+	".3", /* SQLITE2MDOC_MDOC */
+	".3.html", /* SQLITE2MDOC_HTML */
+	".3.md", /* SQLITE2MDOC_MARKDOWN */
+	".3", /* SQLITE2MDOC_JSON */
+};
+
+/*
+ * Parse "sz" bytes of "buf", naming it "fn" in warnings.
+ * The final line need not be newline-terminated and lines are cut at
+ * any NUL byte.
+ * Returns the parse or NULL if the input ends in the middle of an
+ * interface description.
+ */
+struct sqlite2mdoc *
+sqlite2mdoc_parse(const char *fn, const char *buf, size_t sz,
+	unsigned int flags)
+{
+	struct sqlite2mdoc	*s;
+
+	if ((s = calloc(1, sizeof(struct sqlite2mdoc))) == NULL)
+		err(1, NULL);
+	if ((s->fn = strdup(fn == NULL ? "<buffer>" : fn)) == NULL)
+		err(1, NULL);
+
+	parse_init(&s->p, s->fn);
+	s->p.verbose = (flags & SQLITE2MDOC_VERBOSE) != 0;
+	parse_buf(&s->p, buf, sz);
+
+	if (!parse_finish(&s->p)) {
+		sqlite2mdoc_free(s);
+		return NULL;
+	}
+	return s;
+}
+
+/*
+ * Post-process all definitions, giving them filenames suitable for the
+ * given output type.
+ * This must be called exactly once before the pages are used.
+ * Returns zero if it has already been called, non-zero otherwise.
+ */
+int
+sqlite2mdoc_postprocess(struct sqlite2mdoc *s, enum sqlite2mdoc_type type)
+{
+	struct defn	*d;
+
+	if (s->postprocessed || type >= SQLITE2MDOC__MAX)
+		return 0;
+	for (d = s->p.defs; d < s->p.defs + s->p.defsz; d++)
+		parse_postprocess(d, suffixes[type]);
+	xref_order(s->p.defs, s->p.defsz);
+	s->postprocessed = 1;
+	return 1;
+}
+
+void
+sqlite2mdoc_free(struct sqlite2mdoc *s)
+{
+
+	if (s == NULL)
+		return;
+	parse_free(&s->p);
+	buf_free(&s->ob);
+	free(s->fn);
+	free(s);
+}
+
+/*
+ * Iterate over pages in input order, skipping those that couldn't be
+ * post-processed.
+ */
+const struct sqlite2mdoc_page *
+sqlite2mdoc_first(const struct sqlite2mdoc *s)
+{
+	const struct defn	*d;
+
+	for (d = s->p.defs; d < s->p.defs + s->p.defsz; d++)
+		if (d->postprocessed)
+			return (const struct sqlite2mdoc_page *)d;
+	return NULL;
+}
+
+const struct sqlite2mdoc_page *
+sqlite2mdoc_next(const struct sqlite2mdoc_page *pg)
+{
+	const struct defn	*d = (const struct defn *)pg;
+
+	/* The last definition is followed by a zeroed one. */
+
+	for (d++; d->name != NULL; d++)
+		if (d->postprocessed)
+			return (const struct sqlite2mdoc_page *)d;
+	return NULL;
+}
+
+/*
+ * Look up the page documenting a keyword or name.
+ * Returns the page or NULL if not found.
+ */
+const struct sqlite2mdoc_page *
+sqlite2mdoc_find(const struct sqlite2mdoc *s, const char *key)
+{
+	const struct defn	*d;
+
+	if ((d = xref_lookup(&s->p.keys, key)) == NULL ||
+	    !d->postprocessed)
+		return NULL;
+	return (const struct sqlite2mdoc_page *)d;
+}
+
+/*
+ * Filename of the page, with the suffix of the output type given to
+ * sqlite2mdoc_postprocess().
+ */
+const char *
+sqlite2mdoc_page_file(const struct sqlite2mdoc_page *pg)
+{
+
+	return ((const struct defn *)pg)->fname;
+}
+
+/*
+ * Primary name of the page, such as "sqlite3_open".
+ */
+const char *
+sqlite2mdoc_page_name(const struct sqlite2mdoc_page *pg)
+{
+
+	return ((const struct defn *)pg)->nms[0];
+}
+
+/*
+ * Line of the input at which the page's description begins.
+ */
+size_t
+sqlite2mdoc_page_line(const struct sqlite2mdoc_page *pg)
+{
+
+	return ((const struct defn *)pg)->ln;
+}
+
+/*
+ * Render a page in the given type and pass it to "writer".
+ * Returns zero if the writer fails, non-zero on success.
+ */
+int
+sqlite2mdoc_render(struct sqlite2mdoc *s,
+	const struct sqlite2mdoc_page *pg, enum sqlite2mdoc_type type,
+	sqlite2mdoc_writer writer, void *arg)
+{
+	const struct defn	*d = (const struct defn *)pg;
+
+	buf_reset(&s->ob);
+
+	switch (type) {
+	case SQLITE2MDOC_MDOC:
+		print_mdoc(&s->ob, d, s->p.verbose);
+		break;
+	case SQLITE2MDOC_HTML:
+		print_html(&s->ob, d, s->p.verbose);
+		break;
+	case SQLITE2MDOC_MARKDOWN:
+		print_markdown(&s->ob, d, s->p.verbose);
+		break;
+	case SQLITE2MDOC_JSON:
+		print_json(&s->ob, d, s->p.verbose);
+		break;
+	default:
+		return 0;
+	}
+
+	return writer(arg, s->ob.data, s->ob.sz);
+}
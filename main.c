@@ -18,17 +18,20 @@
 #if HAVE_SYS_QUEUE
 # include <sys/queue.h>
 #endif
+#include <sys/stat.h>
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
 #if HAVE_ERR
 # include <err.h>
 #endif
+#include <fcntl.h>
 #include <getopt.h>
+#include <limits.h>
 #if HAVE_SANDBOX_INIT
 # include <sandbox.h>
 #endif
-#include <search.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,942 +48,249 @@ static	int nofile;
 /* Print out only filename. */
 static	int filename;
 
-static void
-decl_function_add(struct parse *p, char **etext,
-	size_t *etextsz, const char *cp, size_t len)
-{
+/* Write all pages into this ustar(5) archive (or NULL). */
+static	FILE *archive;
 
-	if ((*etext)[*etextsz - 1] != ' ') {
-		*etext = realloc(*etext, *etextsz + 2);
-		if (*etext == NULL)
-			err(1, NULL);
-		(*etextsz)++;
-		strlcat(*etext, " ", *etextsz + 1);
-	}
-	*etext = realloc(*etext, *etextsz + len + 1);
-	if (*etext == NULL)
-		err(1, NULL);
-	memcpy(*etext + *etextsz, cp, len);
-	*etextsz += len;
-	(*etext)[*etextsz] = '\0';
-}
+/* Scratch buffer for rendering each manpage. */
+static	struct buf ob;
 
-static void
-decl_function_copy(struct parse *p, char **etext,
-	size_t *etextsz, const char *cp, size_t len)
-{
+/* Output directory if writing files, else -1. */
+static	int dfd = -1;
 
-	*etext = malloc(len + 1);
-	if (*etext == NULL)
-		err(1, NULL);
-	memcpy(*etext, cp, len);
-	*etextsz = len;
-	(*etext)[*etextsz] = '\0';
-}
+/* Type of document to produce. */
+static	enum outtype outtype = OUTTYPE_MDOC;
 
-/*
- * A C function (or variable, or whatever).
- * This is more specifically any non-preprocessor text.
- */
-static int
-decl_function(struct parse *p, const char *cp, size_t len)
-{
-	char		*ep, *lcp, *rcp;
-	const char	*ncp;
-	size_t		 nlen;
-	struct defn	*d;
-	struct decl	*e;
+/* Statistics, if collected (-S), and whether as JSON. */
+static	struct stats st;
+static	int statsjson;
 
-	/* Fetch current interface definition. */
-	d = TAILQ_LAST(&p->dqhead, defnq);
-	assert(NULL != d);
+/* Only produce pages with a name or keyword matching this (or NULL). */
+static	const char *filter;
 
-	/*
-	 * Since C tokens are semicolon-separated, we may be invoked any
-	 * number of times per a single line.
-	 */
-again:
-	while (isspace((unsigned char)*cp)) {
-		cp++;
-		len--;
-	}
-	if (*cp == '\0')
-		return(1);
-
-	/* Whether we're a continuation clause. */
-	if (d->multiline) {
-		/* This might be NULL if we're not a continuation. */
-		e = TAILQ_LAST(&d->dcqhead, declq);
-		assert(DECLTYPE_C == e->type);
-		assert(NULL != e);
-		assert(NULL != e->text);
-		assert(e->textsz);
-	} else {
-		assert(d->instruct == 0);
-		e = calloc(1, sizeof(struct decl));
-		if (e == NULL)
-			err(1, NULL);
-		e->type = DECLTYPE_C;
-		TAILQ_INSERT_TAIL(&d->dcqhead, e, entries);
-	}
+/* Keep running and regenerate pages when the input changes. */
+static	int watching;
 
-	/*
-	 * We begin by seeing if there's a semicolon on this line.
-	 * If there is, we'll need to do some special handling.
-	 */
-	ep = strchr(cp, ';');
-	lcp = strchr(cp, '{');
-	rcp = strchr(cp, '}');
-
-	/* We're only a partial statement (i.e., no closure). */
-	if (ep == NULL && d->multiline) {
-		assert(e->text != NULL);
-		assert(e->textsz > 0);
-		/* Is a struct starting or ending here? */
-		if (d->instruct && NULL != rcp)
-			d->instruct--;
-		else if (NULL != lcp)
-			d->instruct++;
-		decl_function_add(p, &e->text, &e->textsz, cp, len);
-		return(1);
-	} else if (ep == NULL && !d->multiline) {
-		d->multiline = 1;
-		/* Is a structure starting in this line? */
-		if (NULL != lcp &&
-		    (rcp == NULL || rcp < lcp))
-			d->instruct++;
-		decl_function_copy(p, &e->text, &e->textsz, cp, len);
-		return(1);
-	}
+/* Number of documents produced so far. */
+static	size_t npages;
 
-	/* Position ourselves after the semicolon. */
-	assert(NULL != ep);
-	ncp = cp;
-	nlen = (ep - cp) + 1;
-	cp = ep + 1;
-	len -= nlen;
-
-	if (d->multiline) {
-		assert(NULL != e->text);
-		/* Don't stop the multi-line if we're in a struct. */
-		if (d->instruct == 0) {
-			if (lcp == NULL || lcp > cp)
-				d->multiline = 0;
-		} else if (NULL != rcp && rcp < cp)
-			if (--d->instruct == 0)
-				d->multiline = 0;
-		decl_function_add(p, &e->text, &e->textsz, ncp, nlen);
-	} else {
-		assert(e->text == NULL);
-		if (NULL != lcp && lcp < cp) {
-			d->multiline = 1;
-			d->instruct++;
-		}
-		decl_function_copy(p, &e->text, &e->textsz, ncp, nlen);
-	}
+/* Whether any page failed to be written. */
+static	int wrfail;
 
-	goto again;
-}
-
-/*
- * A definition is just #define followed by space followed by the name,
- * then the value of that name.
- * We ignore the latter.
- * FIXME: this does not understand multi-line CPP, but I don't think
- * there are any instances of that in sqlite3.h.
- */
-static int
-decl_define(struct parse *p, const char *cp, size_t len)
-{
-	struct defn	*d;
-	struct decl	*e;
-	size_t		 sz;
-
-	while (isspace((unsigned char)*cp)) {
-		cp++;
-		len--;
-	}
-	if (len == 0) {
-		warnx("%s:%zu: empty pre-processor "
-			"constant", p->fn, p->ln);
-		return(1);
-	}
-
-	d = TAILQ_LAST(&p->dqhead, defnq);
-	assert(NULL != d);
-
-	/*
-	 * We're parsing a preprocessor definition, but we're still
-	 * waiting on a semicolon from a function definition.
-	 * It might be a comment or an error.
-	 */
-	if (d->multiline) {
-		if (verbose)
-			warnx("%s:%zu: multiline declaration "
-				"still open", p->fn, p->ln);
-		e = TAILQ_LAST(&d->dcqhead, declq);
-		assert(NULL != e);
-		e->type = DECLTYPE_NEITHER;
-		d->multiline = d->instruct = 0;
-	}
+/* Filename suffix for each output type. */
+static	const char *const suffixes[OUTTYPE__MAX] = {
+	".3", /* OUTTYPE_MDOC */
+	".3.html", /* OUTTYPE_HTML */
+	".3.md", /* OUTTYPE_MARKDOWN */
+	".3", /* OUTTYPE_JSON */
+	".3", /* OUTTYPE_JSONL */
+};
 
-	sz = 0;
-	while (cp[sz] != '\0' && !isspace((unsigned char)cp[sz]))
-		sz++;
-
-	e = calloc(1, sizeof(struct decl));
-	if (e == NULL)
-		err(1, NULL);
-	e->type = DECLTYPE_CPP;
-	e->text = calloc(1, sz + 1);
-	if (e->text == NULL)
-		err(1, NULL);
-	strlcpy(e->text, cp, sz + 1);
-	e->textsz = sz;
-	TAILQ_INSERT_TAIL(&d->dcqhead, e, entries);
-	return(1);
-}
+/* Argument to -T for each output type. */
+static	const char *const outtypes[OUTTYPE__MAX] = {
+	"mdoc", /* OUTTYPE_MDOC */
+	"html", /* OUTTYPE_HTML */
+	"markdown", /* OUTTYPE_MARKDOWN */
+	"json", /* OUTTYPE_JSON */
+	"jsonl", /* OUTTYPE_JSONL */
+};
 
 /*
- * A declaration is a function, variable, preprocessor definition, or
- * really anything else until we reach a blank line.
+ * Write a rendered document as a file within the prefix, to stdout, or
+ * as an archive member.
  */
 static void
-decl(struct parse *p, const char *cp, size_t len)
+print_page_write(const struct defn *d)
 {
-	struct defn	*d;
-	struct decl	*e;
-	const char	*oldcp;
-	size_t		 oldlen;
+	size_t		 off;
+	ssize_t		 ssz;
+	int		 fd;
 
-	oldcp = cp;
-	oldlen = len;
-
-	while (isspace((unsigned char)*cp)) {
-		cp++;
-		len--;
-	}
-
-	d = TAILQ_LAST(&p->dqhead, defnq);
-	assert(NULL != d);
-
-	/* Check closure. */
-	if (*cp == '\0') {
-		p->phase = PHASE_INIT;
-		/* Check multiline status. */
-		if (d->multiline) {
-			if (verbose)
-				warnx("%s:%zu: multiline declaration "
-					"still open", p->fn, p->ln);
-			e = TAILQ_LAST(&d->dcqhead, declq);
-			assert(NULL != e);
-			e->type = DECLTYPE_NEITHER;
-			d->multiline = d->instruct = 0;
-		}
+	if (archive != NULL) {
+		if (!archive_write(archive, d->fname, &ob))
+			wrfail = 1;
+		return;
+	} else if (nofile) {
+		fwrite(ob.data, ob.sz, 1, stdout);
 		return;
 	}
 
-	d->fulldesc = realloc(d->fulldesc,
-		d->fulldescsz + oldlen + 2);
-	if (d->fulldesc == NULL)
-		err(1, NULL);
-	if (d->fulldescsz == 0)
-		d->fulldesc[0] = '\0';
-	d->fulldescsz += oldlen + 2;
-	strlcat(d->fulldesc, oldcp, d->fulldescsz);
-	strlcat(d->fulldesc, "\n", d->fulldescsz);
-	
 	/*
-	 * Catch preprocessor defines, but discard all other types of
-	 * preprocessor statements.
-	 * We might already be in the middle of a declaration (a
-	 * function declaration), but that's ok.
+	 * Write the whole page relative to the output directory.
+	 * This will almost always be a single write(2).
 	 */
 
-	if (*cp == '#') {
-		len--;
-		cp++;
-		while (isspace((unsigned char)*cp)) {
-			len--;
-			cp++;
-		}
-		if (strncmp(cp, "define", 6) == 0)
-			decl_define(p, cp + 6, len - 6);
+	fd = openat(dfd, d->fname, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+	if (fd == -1) {
+		warn("%s: openat", d->fname);
+		wrfail = 1;
 		return;
 	}
-
-	/* Skip one-liner comments. */
-
-	if (len > 4 &&
-	    cp[0] == '/' && cp[1] == '*' &&
-	    cp[len - 2] == '*' && cp[len - 1] == '/')
-		return;
-
-	decl_function(p, cp, len);
-}
-
-/*
- * Whether to end an interface description phase with an asterisk-slash.
- * This is run within a phase already opened with slash-asterisk.  It
- * adjusts the parse state on ending a phase or syntax errors.  It has
- * various hacks around lacks syntax (e.g., starting single-asterisk
- * instead of double-asterisk) found in the wild.
- *
- * Returns zero if not ending the phase, non-zero if ending.
- */
-static int
-endphase(struct parse *p, const char *cp)
-{
-
-	if (*cp == '\0') {
-		/*
-		 * Error: empty line.
-		 */
-		warnx("%s:%zu: warn: unexpected empty line in "
-			"interface description", p->fn, p->ln);
-		p->phase = PHASE_INIT;
-		return 1;
-	} else if (strcmp(cp, "*/") == 0) {
-		/*
-		 * End of the interface description.
-		 */
-		p->phase = PHASE_DECL;
-		return 1;
-	} else if (!(cp[0] == '*' && cp[1] == '*')) {
-		/*
-		 * Error: bad syntax, not end or continuation.
-		 */
-		if (cp[0] == '*' && cp[1] == '\0') {
-			if (verbose)
-				warnx("%s:%zu: warn: ignoring "
-					"standalone asterisk "
-					"in interface description",
-					p->fn, p->ln);
-			return 0;
-		} else if (cp[0] == '*' && cp[1] == ' ') {
-			if (verbose)
-				warnx("%s:%zu: warn: ignoring "
-					"leading single asterisk "
-					"in interface description",
-					p->fn, p->ln);
-			return 0;
+	for (off = 0; off < ob.sz; off += (size_t)ssz)
+		if ((ssz = write(fd, ob.data + off, ob.sz - off)) == -1) {
+			if (errno == EINTR) {
+				ssz = 0;
+				continue;
+			}
+			warn("%s: write", d->fname);
+			wrfail = 1;
+			break;
 		}
-		warnx("%s:%zu: warn: ambiguous leading characters in "
-			"interface description", p->fn, p->ln);
-		p->phase = PHASE_INIT;
-		return 1;
-	}
-
-	/* If here, at a continuation ('**'). */
-
-	return 0;
-}
-
-/*
- * Parse a "SEE ALSO" phase, which can come at any point in the
- * interface description (unlike what they claim).
- */
-static void
-seealso(struct parse *p, const char *cp, size_t len)
-{
-	struct defn	*d;
-
-	if (endphase(p, cp) || len < 2)
-		return;
-
-	cp += 2;
-	len -= 2;
-
-	while (isspace((unsigned char)*cp)) {
-		cp++;
-		len--;
-	}
-
-	/* Blank line: back to description part. */
-	if (len == 0) {
-		p->phase = PHASE_DESC;
-		return;
-	}
-
-	/* Fetch current interface definition. */
-	d = TAILQ_LAST(&p->dqhead, defnq);
-	assert(NULL != d);
-
-	d->seealso = realloc(d->seealso,
-		d->seealsosz + len + 1);
-	memcpy(d->seealso + d->seealsosz, cp, len);
-	d->seealsosz += len;
-	d->seealso[d->seealsosz] = '\0';
+	close(fd);
 }
 
 /*
- * A definition description is a block of text that we'll later format
- * in mdoc(7).
- * It extends from the name of the definition down to the declarations
- * themselves.
+ * Emit a document in the chosen output type.
+ * The document is first rendered in its entirety into a buffer, then
+ * written out as a file within the prefix, to stdout, or as an archive
+ * member.
  */
 static void
-desc(struct parse *p, const char *cp, size_t len)
+print_page(const struct defn *d)
 {
-	struct defn	*d;
-	size_t		 nsz;
 
-	if (endphase(p, cp) || len < 2)
+	if (d->filtered)
 		return;
-
-	cp += 2;
-	len -= 2;
-
-	while (isspace((unsigned char)*cp)) {
-		cp++;
-		len--;
-	}
-
-	/* Fetch current interface definition. */
-
-	d = TAILQ_LAST(&p->dqhead, defnq);
-	assert(NULL != d);
-
-	/* Ignore leading blank lines. */
-
-	if (len == 0 && d->desc == NULL)
-		return;
-
-	/* Collect SEE ALSO clauses. */
-
-	if (strncasecmp(cp, "see also:", 9) == 0) {
-		cp += 9;
-		len -= 9;
-		while (isspace((unsigned char)*cp)) {
-			cp++;
-			len--;
-		}
-		p->phase = PHASE_SEEALSO;
-		d->seealso = realloc(d->seealso,
-			d->seealsosz + len + 1);
-		memcpy(d->seealso + d->seealsosz, cp, len);
-		d->seealsosz += len;
-		d->seealso[d->seealsosz] = '\0';
-		return;
-	}
-
-	/* White-space padding between lines. */
-
-	if (d->desc != NULL &&
-	    d->descsz > 0 &&
-	    d->desc[d->descsz - 1] != ' ' &&
-	    d->desc[d->descsz - 1] != '\n') {
-		d->desc = realloc(d->desc, d->descsz + 2);
-		if (d->desc == NULL)
-			err(1, NULL);
-		d->descsz++;
-		strlcat(d->desc, " ", d->descsz + 1);
-	}
-
-	/* Either append the line of a newline, if blank. */
-
-	nsz = len == 0 ? 1 : len;
-	if (d->desc == NULL) {
-		assert(d->descsz == 0);
-		d->desc = calloc(1, nsz + 1);
-		if (d->desc == NULL)
-			err(1, NULL);
-	} else {
-		d->desc = realloc(d->desc, d->descsz + nsz + 1);
-		if (d->desc == NULL)
-			err(1, NULL);
-	}
-
-	d->descsz += nsz;
-	strlcat(d->desc, len == 0 ? "\n" : cp, d->descsz + 1);
-}
-
-/*
- * Copy all KEYWORDS into a buffer.
- */
-static void
-keys(struct parse *p, const char *cp, size_t len)
-{
-	struct defn	*d;
-
-	if (endphase(p, cp) || len < 2)
+	if (!d->postprocessed) {
+		warnx("%s:%zu: interface has errors, not "
+			"producing manpage", d->fn, d->ln);
 		return;
-
-	cp += 2;
-	len -= 2;
-	while (isspace((unsigned char)*cp)) {
-		cp++;
-		len--;
 	}
 
-	if (len == 0) {
-		p->phase = PHASE_DESC;
-		return;
-	} else if (strncmp(cp, "KEYWORDS:", 9))
-		return;
-
-	cp += 9;
-	len -= 9;
-
-	d = TAILQ_LAST(&p->dqhead, defnq);
-	assert(NULL != d);
-	d->keybuf = realloc(d->keybuf, d->keybufsz + len + 1);
-	if (d->keybuf == NULL)
-		err(1, NULL);
-	memcpy(d->keybuf + d->keybufsz, cp, len);
-	d->keybufsz += len;
-	d->keybuf[d->keybufsz] = '\0';
-}
-
-/*
- * Initial state is where we're scanning forward to find commented
- * instances of CAPI3REF.
- */
-static void
-init(struct parse *p, const char *cp)
-{
-	struct defn	*d;
-	size_t		 i, sz;
-
-	/* Look for comment hook. */
-
-	if (cp[0] != '*' || cp[1] != '*')
-		return;
-	cp += 2;
-	while (isspace((unsigned char)*cp))
-		cp++;
-
-	/* Look for beginning of definition. */
-
-	if (strncmp(cp, "CAPI3REF:", 9))
-		return;
-	cp += 9;
-	while (isspace((unsigned char)*cp))
-		cp++;
-	if (*cp == '\0') {
-		warnx("%s:%zu: warn: unexpected end of "
-			"interface definition", p->fn, p->ln);
+	if (filename) {
+		printf("%s\n", d->fname);
 		return;
 	}
 
-	/* Add definition to list of existing ones. */
-
-	if ((d = calloc(1, sizeof(struct defn))) == NULL)
-		err(1, NULL);
-	if ((d->name = strdup(cp)) == NULL)
-		err(1, NULL);
-
-	/* Strip trailing spaces and periods. */
-
-	for (sz = strlen(d->name); sz > 0; sz--)
-		if (d->name[sz - 1] == '.' ||
-		    d->name[sz - 1] == ' ')
-			d->name[sz - 1] = '\0';
-		else
-			break;
-
-	/*
-	 * Un-title case.  Use a simple heuristic where all words
-	 * starting with an upper case letter followed by a not
-	 * uppercase letter are lowercased.
-	 */
-
-	for (i = 0; sz > 0 && i < sz - 1; i++)
-		if ((i == 0 || d->name[i - 1] == ' ') &&
-		    isupper((unsigned char)d->name[i]) &&
-		    !isupper((unsigned char)d->name[i + 1]) &&
-		    !ispunct((unsigned char)d->name[i + 1]))
-			d->name[i] = tolower((unsigned char)d->name[i]);
-
-	d->fn = p->fn;
-	d->ln = p->ln;
-	p->phase = PHASE_KEYS;
-	TAILQ_INIT(&d->dcqhead);
-	TAILQ_INSERT_TAIL(&p->dqhead, d, entries);
+	buf_reset(&ob);
+	stats_begin();
+
+	switch (outtype) {
+	case OUTTYPE_JSON:
+		buf_puts(&ob, npages == 0 ? "[\n" : ",\n");
+		print_json(&ob, d, verbose);
+		break;
+	case OUTTYPE_JSONL:
+		print_json(&ob, d, verbose);
+		buf_putc(&ob, '\n');
+		break;
+	case OUTTYPE_HTML:
+		print_html(&ob, d, verbose);
+		break;
+	case OUTTYPE_MARKDOWN:
+		print_markdown(&ob, d, verbose);
+		break;
+	case OUTTYPE_MDOC:
+		print_mdoc(&ob, d, verbose);
+		break;
+	default:
+		abort();
+	}
+
+	npages++;
+	stats_end(STAGE_RENDER);
+
+	if (stats != NULL) {
+		stats->pages++;
+		stats->outsz += ob.sz;
+	}
+
+	stats_begin();
+	print_page_write(d);
+	stats_end(STAGE_WRITE);
 }
 
-#define	BPOINT(_cp) \
-	(';' == (_cp)[0] || \
-	 '[' == (_cp)[0] || \
-	 ('(' == (_cp)[0] && '*' != (_cp)[1]) || \
-	 ')' == (_cp)[0] || \
-	 '{' == (_cp)[0])
-
 /*
- * Given a declaration (be it preprocessor or C), try to parse out a
- * reasonable "name" for the affair.
- * For a struct, for example, it'd be the struct name.
- * For a typedef, it'd be the type name.
- * For a function, it'd be the function name.
+ * Remove the file of a page that no longer exists (watch mode).
  */
 static void
-grok_name(const struct decl *e,
-	const char **start, size_t *sz)
+remove_page(const char *fname)
 {
-	const char	*cp;
-
-	*start = NULL;
-	*sz = 0;
 
-	if (DECLTYPE_CPP != e->type) {
-		if (e->text[e->textsz - 1] != ';')
-			return;
-		cp = e->text;
-		do {
-			while (isspace((unsigned char)*cp))
-				cp++;
-			if (BPOINT(cp))
-				break;
-			/* Function pointers... */
-			if (*cp == '(')
-				cp++;
-			/* Pass over pointers. */
-			while (*cp == '*')
-				cp++;
-			*start = cp;
-			*sz = 0;
-			while (!isspace((unsigned char)*cp)) {
-				if (BPOINT(cp))
-					break;
-				cp++;
-				(*sz)++;
-			}
-		} while (!BPOINT(cp));
-	} else {
-		*sz = e->textsz;
-		*start = e->text;
-	}
+	if (unlinkat(dfd, fname, 0) == -1 && errno != ENOENT)
+		warn("%s: unlinkat", fname);
 }
 
 /*
- * Extract information from the interface definition.
- * Mark it as "postprocessed" on success.
+ * Read the whole of "fn" into "buf", which is reallocated as needed.
+ * Returns zero on failure, else non-zero with "sz" set.
  */
-static void
-postprocess(const char *prefix, struct defn *d)
+static int
+read_file(const char *fn, char **buf, size_t *sz)
 {
-	struct decl	*first;
-	const char	*start;
-	size_t		 offs, sz, i;
-	ENTRY		 ent;
-
-	if (TAILQ_EMPTY(&d->dcqhead))
-		return;
-
-	/* Find the first #define or declaration. */
-
-	TAILQ_FOREACH(first, &d->dcqhead, entries)
-		if (DECLTYPE_CPP == first->type ||
-		    DECLTYPE_C == first->type)
-			break;
-
-	if (first == NULL) {
-		warnx("%s:%zu: no entry to document", d->fn, d->ln);
-		return;
-	}
-
-	/*
-	 * Now compute the document name (`Dt').
-	 * We'll also use this for the filename.
-	 */
-
-	grok_name(first, &start, &sz);
-	if (start == NULL) {
-		warnx("%s:%zu: couldn't deduce "
-			"entry name", d->fn, d->ln);
-		return;
-	}
-
-	/* Document name needs all-caps. */
-
-	if ((d->dt = strndup(start, sz)) == NULL)
+	struct stat	 st;
+	ssize_t		 ssz;
+	void		*pp;
+	int		 fd;
+
+	if ((fd = open(fn, O_RDONLY)) == -1) {
+		warn("%s", fn);
+		return 0;
+	} else if (fstat(fd, &st) == -1) {
+		warn("%s", fn);
+		close(fd);
+		return 0;
+	}
+	if ((pp = mem_realloc(MEM_PARSE, *buf, st.st_size + 1)) == NULL)
 		err(1, NULL);
-	sz = strlen(d->dt);
-	for (i = 0; i < sz; i++)
-		d->dt[i] = toupper((unsigned char)d->dt[i]);
-
-	/* Filename needs no special chars. */
-
-	if (filename) {
-		asprintf(&d->fname, "%.*s.3", (int)sz, start);
-		offs = 0;
-	} else {
-		asprintf(&d->fname, "%s/%.*s.3",
-			prefix, (int)sz, start);
-		offs = strlen(prefix) + 1;
-	}
-
-	if (d->fname == NULL)
-		err(1, NULL);
-
-	for (i = 0; i < sz; i++) {
-		if (isalnum((unsigned char)d->fname[offs + i]) ||
-		    d->fname[offs + i] == '_' ||
-		    d->fname[offs + i] == '-')
-			continue;
-		d->fname[offs + i] = '_';
-	}
-
-	/*
-	 * First, extract all keywords.
-	 */
-	for (i = 0; i < d->keybufsz; ) {
-		while (isspace((unsigned char)d->keybuf[i]))
-			i++;
-		if (i == d->keybufsz)
-			break;
-		sz = 0;
-		start = &d->keybuf[i];
-		if (d->keybuf[i] == '{') {
-			start = &d->keybuf[++i];
-			for ( ; i < d->keybufsz; i++, sz++)
-				if (d->keybuf[i] == '}')
-					break;
-			if (d->keybuf[i] == '}')
-				i++;
-		} else
-			for ( ; i < d->keybufsz; i++, sz++)
-				if (isspace((unsigned char)d->keybuf[i]))
-					break;
-		if (sz == 0)
-			continue;
-		d->keys = reallocarray(d->keys,
-			d->keysz + 1, sizeof(char *));
-		if (d->keys == NULL)
-			err(1, NULL);
-		d->keys[d->keysz] = malloc(sz + 1);
-		if (d->keys[d->keysz] == NULL)
-			err(1, NULL);
-		memcpy(d->keys[d->keysz], start, sz);
-		d->keys[d->keysz][sz] = '\0';
-		d->keysz++;
-		
-		/* Hash the keyword. */
-		ent.key = d->keys[d->keysz - 1];
-		ent.data = d;
-		(void)hsearch(ent, ENTER);
-	}
-
-	/*
-	 * Now extract all `Nm' values for this document.
-	 * We only use CPP and C references, and hope for the best when
-	 * doing so.
-	 * Enter each one of these as a searchable keyword.
-	 */
-	TAILQ_FOREACH(first, &d->dcqhead, entries) {
-		if (DECLTYPE_CPP != first->type &&
-		    DECLTYPE_C != first->type)
+	*buf = pp;
+	for (*sz = 0; *sz < (size_t)st.st_size; *sz += ssz) {
+		ssz = read(fd, *buf + *sz, st.st_size - *sz);
+		if (ssz == -1 && errno == EINTR) {
+			ssz = 0;
 			continue;
-		grok_name(first, &start, &sz);
-		if (start == NULL)
-			continue;
-		d->nms = reallocarray(d->nms,
-			d->nmsz + 1, sizeof(char *));
-		if (d->nms == NULL)
-			err(1, NULL);
-		d->nms[d->nmsz] = malloc(sz + 1);
-		if (d->nms[d->nmsz] == NULL)
-			err(1, NULL);
-		memcpy(d->nms[d->nmsz], start, sz);
-		d->nms[d->nmsz][sz] = '\0';
-		d->nmsz++;
-
-		/* Hash the name. */
-		ent.key = d->nms[d->nmsz - 1];
-		ent.data = d;
-		(void)hsearch(ent, ENTER);
-	}
-
-	if (d->nmsz == 0) {
-		warnx("%s:%zu: couldn't deduce "
-			"any names", d->fn, d->ln);
-		return;
-	}
-
-	/*
-	 * Next, scan for all `Xr' values.
-	 * We'll add more to this list later.
-	 */
-	for (i = 0; i < d->seealsosz; i++) {
-		/*
-		 * Find next value starting with `['.
-		 * There's other stuff in there (whitespace or
-		 * free text leading up to these) that we're ok
-		 * to ignore.
-		 */
-		while (i < d->seealsosz && d->seealso[i] != '[')
-			i++;
-		if (i == d->seealsosz)
-			break;
-
-		/*
-		 * Now scan for the matching `]'.
-		 * We can also have a vertical bar if we're separating a
-		 * keyword and its shown name.
-		 */
-		start = &d->seealso[++i];
-		sz = 0;
-		while (i < d->seealsosz &&
-		      d->seealso[i] != ']' &&
-		      d->seealso[i] != '|') {
-			i++;
-			sz++;
-		}
-		if (i == d->seealsosz)
-			break;
-		if (sz == 0)
-			continue;
-
-		/*
-		 * Continue on to the end-of-reference, if we weren't
-		 * there to begin with.
-		 */
-		if (d->seealso[i] != ']')
-			while (i < d->seealsosz &&
-			      d->seealso[i] != ']')
-				i++;
-
-		/* Strip trailing whitespace. */
-		while (sz > 1 && start[sz - 1] == ' ')
-			sz--;
-
-		/* Strip trailing parenthesis. */
-		if (sz > 2 &&
-		    start[sz - 2] == '(' &&
-	 	    start[sz - 1] == ')')
-			sz -= 2;
-
-		d->xrs = reallocarray(d->xrs,
-			d->xrsz + 1, sizeof(char *));
-		if (d->xrs == NULL)
-			err(1, NULL);
-		d->xrs[d->xrsz] = malloc(sz + 1);
-		if (d->xrs[d->xrsz] == NULL)
-			err(1, NULL);
-		memcpy(d->xrs[d->xrsz], start, sz);
-		d->xrs[d->xrsz][sz] = '\0';
-		d->xrsz++;
-	}
-
-	/*
-	 * Next, extract all references.
-	 * We'll accumulate these into a list of SEE ALSO tags, after.
-	 * See how these are parsed above for a description: this is
-	 * basically the same thing.
-	 */
-	for (i = 0; i < d->descsz; i++) {
-		if (d->desc[i] != '[')
-			continue;
-		i++;
-		if (d->desc[i] == '[')
-			continue;
-
-		start = &d->desc[i];
-		for (sz = 0; i < d->descsz; i++, sz++)
-			if (d->desc[i] == ']' ||
-			    d->desc[i] == '|')
-				break;
-
-		if (i == d->descsz)
+		} else if (ssz == -1) {
+			warn("%s", fn);
+			close(fd);
+			return 0;
+		} else if (ssz == 0)
 			break;
-		else if (sz == 0)
-			continue;
-
-		if (d->desc[i] != ']')
-			while (i < d->descsz && d->desc[i] != ']')
-				i++;
-
-		while (sz > 1 && start[sz - 1] == ' ')
-			sz--;
-
-		if (sz > 2 &&
-		    start[sz - 2] == '(' &&
-		    start[sz - 1] == ')')
-			sz -= 2;
-
-		d->xrs = reallocarray(d->xrs,
-			d->xrsz + 1, sizeof(char *));
-		if (d->xrs == NULL)
-			err(1, NULL);
-		d->xrs[d->xrsz] = malloc(sz + 1);
-		if (d->xrs[d->xrsz] == NULL)
-			err(1, NULL);
-		memcpy(d->xrs[d->xrsz], start, sz);
-		d->xrs[d->xrsz][sz] = '\0';
-		d->xrsz++;
 	}
-
-	d->postprocessed = 1;
+	close(fd);
+	return 1;
 }
 
 /*
- * Emit a valid mdoc(7) document within the given prefix.
+ * Watch mode: produce all pages, then wait for the input to change and
+ * produce only those pages that may differ, forever.
+ * Returns only on failure.
  */
 static void
-print_mdoc(struct defn *d)
+watch(const char *fn)
 {
-	struct decl	*first;
-	size_t		 i;
-	FILE		*f;
+	struct watch	 w;
+	char		*buf = NULL;
+	size_t		 sz, n;
 
-	if (!d->postprocessed) {
-		warnx("%s:%zu: interface has errors, not "
-			"producing manpage", d->fn, d->ln);
-		return;
-	}
-
-	if (nofile == 0) {
-		if ((f = fopen(d->fname, "w")) == NULL) {
-			warn("%s: fopen", d->fname);
-			return;
-		}
-	} else if (filename) {
-		printf("%s\n", d->fname);
-		return;
-	} else
-		f = stdout;
-
-	/* Begin by outputting the mdoc(7) header. */
-
-	fputs(".Dd $" "Mdocdate$\n", f);
-	fprintf(f, ".Dt %s 3\n", d->dt);
-	fputs(".Os\n", f);
-	fputs(".Sh NAME\n", f);
-
-	/* Now print the name bits of each declaration. */
-
-	for (i = 0; i < d->nmsz; i++)
-		fprintf(f, ".Nm %s%s\n", d->nms[i],
-			i < d->nmsz - 1 ? " ," : "");
-
-	fprintf(f, ".Nd %s\n", d->name);
-
-	fputs(".Sh SYNOPSIS\n", f);
-	fputs(".In sqlite3.h\n", f);
-
-	TAILQ_FOREACH(first, &d->dcqhead, entries)
-		print_synopsis(f, first, d);
-
-	fputs(".Sh DESCRIPTION\n", f);
-	print_description(f, d);
-
-	fputs(".Sh IMPLEMENTATION NOTES\n", f);
-	print_implementation(f, d, verbose);
-
-	if (nofile == 0)
-		fclose(f);
+	watch_init(&w, fn, suffixes[outtype], verbose);
+	w.filter = filter;
+	if (watch_start(&w))
+		do {
+			if (!read_file(fn, &buf, &sz))
+				continue;
+			n = watch_update(&w,
+				buf, sz, print_page, remove_page);
+			if (verbose)
+				warnx("%s: %zu pages produced", fn, n);
+		} while (watch_wait(&w));
+	watch_free(&w);
+	mem_free(buf);
 }
 
 #if HAVE_PLEDGE
 /*
  * We pledge(2) stdio if we're receiving from stdin and writing to
- * stdout, otherwise we need file-creation and writing.
+ * stdout or an already-opened archive, otherwise we need file-creation
+ * and writing.
+ * Watching also needs to re-read the input and remove pages.
  */
 static void
 sandbox_pledge(void)
 {
 
-	if (nofile) {
+	if (watching) {
+		if (pledge("stdio rpath wpath cpath", NULL) == -1)
+			err(1, NULL);
+	} else if (nofile || archive != NULL) {
 		if (pledge("stdio", NULL) == -1)
 			err(1, NULL);
 	} else {
@@ -993,7 +303,8 @@ sandbox_pledge(void)
 #if HAVE_SANDBOX_INIT
 /*
  * Darwin's "seatbelt".
- * If we're writing to stdout, then use pure computation.
+ * If we're writing to stdout or an already-opened archive, then use
+ * pure computation.
  * Otherwise we need file writing.
  */
 static void
@@ -1003,7 +314,8 @@ sandbox_apple(void)
 	int	 rc;
 
 	rc = sandbox_init
-		(nofile ? kSBXProfilePureComputation :
+		(nofile || archive != NULL ?
+		 kSBXProfilePureComputation :
 		 kSBXProfileNoNetwork, SANDBOX_NAMED, &ep);
 	if (rc == 0)
 		return;
@@ -1013,6 +325,97 @@ sandbox_apple(void)
 }
 #endif
 
+/*
+ * Read in line-by-line and process in the phase dictated by our finite
+ * state automaton.
+ * Returns zero if the input ended early or in the middle of an
+ * interface description, non-zero otherwise.
+ */
+static int
+parse_file(struct parse *p, FILE *f)
+{
+	char	*cp = NULL;
+	size_t	 bufsz = 0;
+	ssize_t	 len;
+
+	stats_begin();
+	while ((len = getline(&cp, &bufsz, f)) != -1) {
+		assert(len > 0);
+		p->ln++;
+		if (cp[len - 1] != '\n') {
+			warnx("%s:%zu: unterminated line", p->fn, p->ln);
+			break;
+		}
+
+		/*
+		 * Lines are now always NUL-terminated, and don't allow
+		 * NUL characters in the line.
+		 */
+
+		cp[--len] = '\0';
+		len = strlen(cp);
+
+		parse_line(p, cp, (size_t)len);
+	}
+	free(cp);
+	stats_end(STAGE_PARSE);
+	stats_parse(p);
+
+	/*
+	 * If we hit the last line, then try to process.
+	 * Otherwise, we failed along the way.
+	 * Allow us to be at the declarations or scanning for the next
+	 * clause.
+	 */
+
+	return feof(f) && parse_finish(p);
+}
+
+/*
+ * Emit the pages of "p" that are new or different from those of the
+ * same name in "op", an older version, and list these and the pages
+ * that no longer exist to stdout.
+ * Each line is "added", "changed", or "removed", the page name, and
+ * the filename, separated by tabs.
+ */
+static void
+print_changes(const struct parse *op, const struct parse *p)
+{
+	struct keytab		 names;
+	const struct defn	*d, *od;
+	const char		*change;
+
+	memset(&names, 0, sizeof(struct keytab));
+	for (od = op->defs; od < op->defs + op->defsz; od++)
+		if (od->postprocessed)
+			keytab_insert(&names, od->nms[0], od);
+
+	for (d = p->defs; d < p->defs + p->defsz; d++) {
+		if (!d->postprocessed) {
+			print_page(d);
+			continue;
+		}
+		if ((od = keytab_find(&names, d->nms[0])) == NULL)
+			change = "added";
+		else if (compare_defn(od, d))
+			change = "changed";
+		else
+			continue;
+		printf("%s\t%s\t%s\n", change, d->nms[0], d->fname);
+		print_page(d);
+	}
+
+	keytab_free(&names);
+	for (d = p->defs; d < p->defs + p->defsz; d++)
+		if (d->postprocessed)
+			keytab_insert(&names, d->nms[0], d);
+	for (od = op->defs; od < op->defs + op->defsz; od++)
+		if (od->postprocessed &&
+		    keytab_find(&names, od->nms[0]) == NULL)
+			printf("removed\t%s\t%s\n", od->nms[0], od->fname);
+	keytab_free(&names);
+}
+
 /*
  * Check to see whether there are any filename duplicates.
  * This is just a warning, but will really screw things up, since the
@@ -1023,10 +426,8 @@ check_dupes(struct parse *p)
 {
 	const struct defn	*d, *dd;
 
-	TAILQ_FOREACH(d, &p->dqhead, entries)
-		TAILQ_FOREACH_REVERSE(dd, &p->dqhead, defnq, entries) {
-			if (dd == d)
-				break;
+	for (d = p->defs; d < p->defs + p->defsz; d++)
+		for (dd = p->defs + p->defsz - 1; dd > d; dd--) {
 			if (d->fname == NULL ||
 			    dd->fname == NULL ||
 			    strcmp(d->fname, dd->fname))
@@ -1040,26 +441,36 @@ check_dupes(struct parse *p)
 int
 main(int argc, char *argv[])
 {
-	size_t		 i, bufsz;
-	ssize_t		 len;
-	FILE		*f = stdin;
-	char		*cp = NULL;
-	const char	*prefix = ".";
-	struct parse	 p;
-	int		 rc = 0, ch;
+	FILE		*f = stdin, *oldf = NULL;
+	const char	*prefix = ".", *afn = NULL, *sock = NULL;
+	const char	*ofn = NULL, *ifn = NULL, *query = NULL;
+	const char	*search = NULL;
+	char		 ipath[PATH_MAX];
+	FILE		*indexf = NULL;
+	struct parse	 p, op;
+	int		 rc = 0, ch, backrefs = 0;
 	struct defn	*d;
-	struct decl	*e;
 
-	memset(&p, 0, sizeof(struct parse));
+	parse_init(&p, "<stdin>");
+	parse_init(&op, NULL);
 
-	p.fn = "<stdin>";
-	p.ln = 0;
-	p.phase = PHASE_INIT;
-
-	TAILQ_INIT(&p.dqhead);
-
-	while ((ch = getopt(argc, argv, "nNp:v")) != -1)
+	while ((ch = getopt(argc, argv, "a:d:i:k:l:nNp:q:rs:S:T:vw")) != -1)
 		switch (ch) {
+		case 'a':
+			afn = optarg;
+			break;
+		case 'd':
+			ofn = optarg;
+			break;
+		case 'i':
+			ifn = optarg;
+			break;
+		case 'k':
+			search = optarg;
+			break;
+		case 'l':
+			sock = optarg;
+			break;
 		case 'n':
 			nofile = 1;
 			break;
@@ -1070,8 +481,34 @@ main(int argc, char *argv[])
 		case 'p':
 			prefix = optarg;
 			break;
+		case 'q':
+			query = optarg;
+			break;
+		case 'r':
+			backrefs = 1;
+			break;
+		case 's':
+			filter = p.filter = op.filter = optarg;
+			break;
+		case 'S':
+			if (strcmp(optarg, "json") == 0)
+				statsjson = 1;
+			else if (strcmp(optarg, "text") != 0)
+				goto usage;
+			stats = &st;
+			break;
+		case 'T':
+			for (outtype = 0; outtype < OUTTYPE__MAX; outtype++)
+				if (strcmp(optarg, outtypes[outtype]) == 0)
+					break;
+			if (outtype == OUTTYPE__MAX)
+				goto usage;
+			break;
 		case 'v':
-			verbose = 1;
+			verbose = p.verbose = op.verbose = 1;
+			break;
+		case 'w':
+			watching = 1;
 			break;
 		default:
 			goto usage;
@@ -1080,114 +517,207 @@ main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
+	/* Archives hold pages as files, so they need files to hold. */
+
+	if (afn != NULL && (nofile || ifn != NULL || search != NULL ||
+	    sock != NULL || outtype == OUTTYPE_JSON ||
+	    outtype == OUTTYPE_JSONL))
+		goto usage;
+
+	/* Serving needs input files and ignores output options. */
+
+	if (sock != NULL) {
+		if (argc == 0 || watching)
+			goto usage;
+#if HAVE_PLEDGE
+		if (pledge("stdio rpath cpath unix", NULL) == -1)
+			err(1, NULL);
+#endif
+		rc = server_run(sock, argv, argc, verbose);
+		parse_free(&p);
+		return !rc;
+	}
+
+	/* Searching needs only the indices given as arguments. */
+
+	if (search != NULL) {
+		if (argc == 0 || ifn != NULL || query != NULL || watching)
+			goto usage;
+#if HAVE_PLEDGE
+		if (pledge("stdio rpath", NULL) == -1)
+			err(1, NULL);
+#endif
+		rc = index_search(argv, argc, search, suffixes[outtype]);
+		parse_free(&p);
+		return !rc;
+	}
+
+	/*
+	 * Querying needs only the index, which knows its header, and
+	 * always writes to stdout.
+	 */
+
+	if (query != NULL) {
+		if (ifn == NULL || argc > 0 || watching || ofn != NULL ||
+		    backrefs)
+			goto usage;
+#if HAVE_PLEDGE
+		if (pledge("stdio rpath", NULL) == -1)
+			err(1, NULL);
+#endif
+		nofile = 1;
+		rc = index_query(ifn, query, suffixes[outtype], verbose,
+			print_page);
+		if (rc && outtype == OUTTYPE_JSON && !filename)
+			puts(npages > 0 ? "\n]" : "[]");
+		buf_free(&ob);
+		return !rc;
+	}
+
 	if (argc > 1)
 		goto usage;
 
+	/*
+	 * Watching needs an input file and pages as files, and only
+	 * re-creates pages whose own references change.
+	 */
+
+	if (watching && (argc == 0 || nofile || afn != NULL || backrefs ||
+	    outtype == OUTTYPE_JSON || outtype == OUTTYPE_JSONL))
+		goto usage;
+
 	if (argc > 0) {
 		if ((f = fopen(argv[0], "r")) == NULL)
 			err(1, "%s", argv[0]);
 		p.fn = argv[0];
 	}
 
-#if HAVE_SANDBOX_INIT
-	sandbox_apple();
-#elif HAVE_PLEDGE
-	sandbox_pledge();
-#endif
 	/*
-	 * Read in line-by-line and process in the phase dictated by our
-	 * finite state automaton.
+	 * Indexing produces no pages and must be able to read the input
+	 * again for offsets, so it can't be standard input.
 	 */
-	
-	while ((len = getline(&cp, &bufsz, f)) != -1) {
-		assert(len > 0);
-		p.ln++;
-		if (cp[len - 1] != '\n') {
-			warnx("%s:%zu: unterminated line", p.fn, p.ln);
-			break;
-		}
 
-		/*
-		 * Lines are now always NUL-terminated, and don't allow
-		 * NUL characters in the line.
-		 */
+	if (ifn != NULL) {
+		if (argc == 0 || watching || ofn != NULL || filter != NULL)
+			goto usage;
+		if (realpath(argv[0], ipath) == NULL)
+			err(1, "%s", argv[0]);
+		if ((indexf = fopen(ifn, "w")) == NULL)
+			err(1, "%s", ifn);
+		nofile = 1;
+	}
 
-		cp[--len] = '\0';
-		len = strlen(cp);
+	/*
+	 * The list of changes goes to stdout, so pages must go into
+	 * files or an archive elsewhere.
+	 */
 
-		switch (p.phase) {
-		case PHASE_INIT:
-			init(&p, cp);
-			break;
-		case PHASE_KEYS:
-			keys(&p, cp, (size_t)len);
-			break;
-		case PHASE_DESC:
-			desc(&p, cp, (size_t)len);
-			break;
-		case PHASE_SEEALSO:
-			seealso(&p, cp, (size_t)len);
-			break;
-		case PHASE_DECL:
-			decl(&p, cp, (size_t)len);
-			break;
-		}
+	if (ofn != NULL) {
+		if (watching || nofile ||
+		    outtype == OUTTYPE_JSON || outtype == OUTTYPE_JSONL ||
+		    (afn != NULL && strcmp(afn, "-") == 0))
+			goto usage;
+		if ((oldf = fopen(ofn, "r")) == NULL)
+			err(1, "%s", ofn);
+		op.fn = ofn;
 	}
 
+	/* JSON is a single stream that always goes to stdout. */
+
+	if (outtype == OUTTYPE_JSON || outtype == OUTTYPE_JSONL)
+		nofile = 1;
+
 	/*
-	 * If we hit the last line, then try to process.
-	 * Otherwise, we failed along the way.
+	 * Open the output directory once: all pages are created
+	 * relative to it.
+	 * Archives may go to stdout.
 	 */
 
-	if (feof(f)) {
-		/*
-		 * Allow us to be at the declarations or scanning for
-		 * the next clause.
-		 */
-		if (p.phase == PHASE_INIT ||
-		    p.phase == PHASE_DECL) {
-			if (hcreate(5000) == 0)
-				err(1, NULL);
-			TAILQ_FOREACH(d, &p.dqhead, entries)
-				postprocess(prefix, d);
-			check_dupes(&p);
-			TAILQ_FOREACH(d, &p.dqhead, entries)
-				print_mdoc(d);
-			rc = 1;
-		} else if (p.phase != PHASE_DECL)
-			warnx("%s:%zu: exit when not in "
-				"initial state", p.fn, p.ln);
+	if (!nofile && afn == NULL &&
+	    (dfd = open(prefix, O_RDONLY|O_DIRECTORY)) == -1)
+		err(1, "%s", prefix);
+
+	if (afn != NULL) {
+		if (strcmp(afn, "-") == 0)
+			archive = stdout;
+		else if ((archive = fopen(afn, "w")) == NULL)
+			err(1, "%s", afn);
 	}
 
-	while ((d = TAILQ_FIRST(&p.dqhead)) != NULL) {
-		TAILQ_REMOVE(&p.dqhead, d, entries);
-		while ((e = TAILQ_FIRST(&d->dcqhead)) != NULL) {
-			TAILQ_REMOVE(&d->dcqhead, e, entries);
-			free(e->text);
-			free(e);
-		}
-		free(d->name);
-		free(d->desc);
-		free(d->fulldesc);
-		free(d->dt);
-		for (i = 0; i < d->nmsz; i++)
-			free(d->nms[i]);
-		for (i = 0; i < d->xrsz; i++)
-			free(d->xrs[i]);
-		for (i = 0; i < d->keysz; i++)
-			free(d->keys[i]);
-		free(d->keys);
-		free(d->nms);
-		free(d->xrs);
-		free(d->fname);
-		free(d->seealso);
-		free(d->keybuf);
-		free(d);
+#if HAVE_SANDBOX_INIT
+	sandbox_apple();
+#elif HAVE_PLEDGE
+	sandbox_pledge();
+#endif
+
+	if (watching) {
+		fclose(f);
+		watch(argv[0]);
+		parse_free(&p);
+		close(dfd);
+		buf_free(&ob);
+		return 1;
 	}
 
+	/*
+	 * With an older version of the header, emit only pages that
+	 * are new or have changed since then.
+	 */
+
+	if (parse_file(&p, f) &&
+	    (oldf == NULL || parse_file(&op, oldf))) {
+		stats_begin();
+		for (d = p.defs; d < p.defs + p.defsz; d++)
+			parse_postprocess(d, suffixes[outtype]);
+		for (d = op.defs; d < op.defs + op.defsz; d++)
+			parse_postprocess(d, suffixes[outtype]);
+		check_dupes(&p);
+		xref_order(p.defs, p.defsz);
+		xref_order(op.defs, op.defsz);
+		if (backrefs) {
+			xref_invert(p.defs, p.defsz);
+			xref_invert(op.defs, op.defsz);
+		}
+		stats_end(STAGE_POSTPROCESS);
+		if (indexf != NULL)
+			rc = index_write(indexf, f, ipath, &p,
+				suffixes[outtype]);
+		else if (oldf != NULL)
+			print_changes(&op, &p);
+		else
+			for (d = p.defs; d < p.defs + p.defsz; d++)
+				print_page(d);
+		if (indexf == NULL && outtype == OUTTYPE_JSON && !filename)
+			puts(npages > 0 ? "\n]" : "[]");
+		if (indexf == NULL)
+			rc = (archive == NULL || archive_close(archive)) &&
+			    !wrfail;
+	}
+
+	stats_print(stderr, statsjson);
+	parse_free(&p);
+	parse_free(&op);
+	if (oldf != NULL)
+		fclose(oldf);
+	if (indexf != NULL && fclose(indexf) == EOF) {
+		warn("%s", ifn);
+		rc = 0;
+	}
+
+	if (archive != NULL && archive != stdout)
+		fclose(archive);
+	if (dfd != -1)
+		close(dfd);
+	buf_free(&ob);
 	return !rc;
 usage:
-	fprintf(stderr, "usage: %s [-Nnv] [-p prefix] [file]\n",
+	fprintf(stderr, "usage: %s [-Nnrvw] [-a archive] [-d oldfile] "
+		"[-i index] [-p prefix] [-s pattern] [-S format] "
+		"[-T type] [file]\n"
+		"       %s [-Nv] -i index -q key [-T type]\n"
+		"       %s [-T type] -k query index ...\n"
+		"       %s [-v] -l socket file ...\n",
+		getprogname(), getprogname(), getprogname(),
 		getprogname());
 	return 1;
 }
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#include <errno.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extern.h"
+
+/*
+ * When collecting statistics, each allocation is prefixed by this
+ * header, which records its size and the subsystem it's charged to.
+ * It's padded to keep the returned pointer suitably aligned.
+ * Otherwise, allocations are passed straight through without one, so
+ * statistics must be enabled before the first allocation or not at all.
+ */
+union	memhdr {
+	struct {
+		size_t		 sz;
+		enum memsys	 sys;
+	} h;
+	max_align_t	 align;
+};
+
+#define	MEMHDR(_p)	((union memhdr *)(_p) - 1)
+
+/*
+ * Charge (or, with a negative sign, credit) "sz" bytes to "sys".
+ */
+static void
+mem_charge(enum memsys sys, size_t sz, int sign)
+{
+	struct memstat	*m;
+
+	if (stats == NULL)
+		return;
+	m = &stats->mem[sys];
+	if (sign < 0) {
+		m->live -= sz;
+		return;
+	}
+	m->live += sz;
+	if (m->live > m->peak)
+		m->peak = m->live;
+}
+
+void *
+mem_malloc(enum memsys sys, size_t sz)
+{
+	union memhdr	*h;
+
+	if (stats == NULL)
+		return malloc(sz);
+	if (sz > SIZE_MAX - sizeof(union memhdr)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	if ((h = malloc(sizeof(union memhdr) + sz)) == NULL)
+		return NULL;
+	h->h.sz = sz;
+	h->h.sys = sys;
+	if (stats != NULL)
+		stats->mem[sys].allocs++;
+	mem_charge(sys, sz, 1);
+	return h + 1;
+}
+
+void *
+mem_calloc(enum memsys sys, size_t nm, size_t sz)
+{
+	void	*p;
+
+	if (stats == NULL)
+		return calloc(nm, sz);
+	if (sz > 0 && nm > SIZE_MAX / sz) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	if ((p = mem_malloc(sys, nm * sz)) != NULL)
+		memset(p, 0, nm * sz);
+	return p;
+}
+
+/*
+ * Resize an allocation.
+ * The whole allocation is then charged to "sys", which may be
+ * different from the one it was first charged to.
+ */
+void *
+mem_realloc(enum memsys sys, void *p, size_t sz)
+{
+	union memhdr	*h;
+	size_t		 osz;
+	enum memsys	 osys;
+
+	if (stats == NULL)
+		return realloc(p, sz);
+	if (p == NULL)
+		return mem_malloc(sys, sz);
+	if (sz > SIZE_MAX - sizeof(union memhdr)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	osz = MEMHDR(p)->h.sz;
+	osys = MEMHDR(p)->h.sys;
+	if ((h = realloc(MEMHDR(p), sizeof(union memhdr) + sz)) == NULL)
+		return NULL;
+	h->h.sz = sz;
+	h->h.sys = sys;
+	if (stats != NULL)
+		stats->mem[sys].reallocs++;
+	mem_charge(osys, osz, -1);
+	mem_charge(sys, sz, 1);
+	return h + 1;
+}
+
+void *
+mem_reallocarray(enum memsys sys, void *p, size_t nm, size_t sz)
+{
+
+	if (sz > 0 && nm > SIZE_MAX / sz) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	return mem_realloc(sys, p, nm * sz);
+}
+
+char *
+mem_strndup(enum memsys sys, const char *cp, size_t sz)
+{
+	char	*p;
+
+	sz = strnlen(cp, sz);
+	if ((p = mem_malloc(sys, sz + 1)) == NULL)
+		return NULL;
+	memcpy(p, cp, sz);
+	p[sz] = '\0';
+	return p;
+}
+
+char *
+mem_strdup(enum memsys sys, const char *cp)
+{
+
+	return mem_strndup(sys, cp, strlen(cp));
+}
+
+int
+mem_asprintf(enum memsys sys, char **ret, const char *fmt, ...)
+{
+	va_list	 ap;
+	int	 sz;
+
+	va_start(ap, fmt);
+	sz = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (sz < 0 || (*ret = mem_malloc(sys, (size_t)sz + 1)) == NULL)
+		return -1;
+	va_start(ap, fmt);
+	vsnprintf(*ret, (size_t)sz + 1, fmt, ap);
+	va_end(ap);
+	return sz;
+}
+
+/*
+ * Free an allocation from any of the mem_*() functions.
+ */
+void
+mem_free(void *p)
+{
+	union memhdr	*h;
+
+	if (stats == NULL) {
+		free(p);
+		return;
+	}
+	if (p == NULL)
+		return;
+	h = MEMHDR(p);
+	if (stats != NULL)
+		stats->mem[h->h.sys].frees++;
+	mem_charge(h->h.sys, h->h.sz, -1);
+	free(h);
+}
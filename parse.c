@@ -0,0 +1,1258 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+
+#include <assert.h>
+#include <ctype.h>
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extern.h"
+
+static void
+decl_function_add(struct parse *p, char **etext,
+	size_t *etextsz, const char *cp, size_t len)
+{
+
+	if ((*etext)[*etextsz - 1] != ' ') {
+		*etext = mem_realloc(MEM_PARSE, *etext, *etextsz + 2);
+		if (*etext == NULL)
+			err(1, NULL);
+		(*etextsz)++;
+		strlcat(*etext, " ", *etextsz + 1);
+	}
+	*etext = mem_realloc(MEM_PARSE, *etext, *etextsz + len + 1);
+	if (*etext == NULL)
+		err(1, NULL);
+	memcpy(*etext + *etextsz, cp, len);
+	*etextsz += len;
+	(*etext)[*etextsz] = '\0';
+}
+
+static void
+decl_function_copy(struct parse *p, char **etext,
+	size_t *etextsz, const char *cp, size_t len)
+{
+
+	*etext = mem_malloc(MEM_PARSE, len + 1);
+	if (*etext == NULL)
+		err(1, NULL);
+	memcpy(*etext, cp, len);
+	*etextsz = len;
+	(*etext)[*etextsz] = '\0';
+}
+
+/*
+ * The definition being parsed.
+ */
+static struct defn *
+parse_last(struct parse *p)
+{
+
+	assert(p->defsz > 0);
+	return &p->defs[p->defsz - 1];
+}
+
+/*
+ * The last declaration of "d".
+ */
+static struct decl *
+decl_last(struct defn *d)
+{
+
+	assert(d->declsz > 0);
+	return &d->decls[d->declsz - 1];
+}
+
+/*
+ * Append a zeroed declaration to "d".
+ */
+static struct decl *
+decl_append(struct defn *d)
+{
+	void	*pp;
+
+	if (d->declsz == d->declmax) {
+		pp = mem_reallocarray(MEM_PARSE, d->decls,
+			d->declmax * 2 + 4, sizeof(struct decl));
+		if (pp == NULL)
+			err(1, NULL);
+		d->decls = pp;
+		d->declmax = d->declmax * 2 + 4;
+	}
+	memset(&d->decls[d->declsz], 0, sizeof(struct decl));
+	return &d->decls[d->declsz++];
+}
+
+/*
+ * A C function (or variable, or whatever).
+ * This is more specifically any non-preprocessor text.
+ */
+static int
+decl_function(struct parse *p, const char *cp, size_t len)
+{
+	char		*ep, *lcp, *rcp;
+	const char	*ncp;
+	size_t		 nlen;
+	struct defn	*d;
+	struct decl	*e;
+
+	/* Fetch current interface definition. */
+	d = parse_last(p);
+
+	/*
+	 * Since C tokens are semicolon-separated, we may be invoked any
+	 * number of times per a single line.
+	 */
+again:
+	while (isspace((unsigned char)*cp)) {
+		cp++;
+		len--;
+	}
+	if (*cp == '\0')
+		return(1);
+
+	/* Whether we're a continuation clause. */
+	if (d->multiline) {
+		e = decl_last(d);
+		assert(DECLTYPE_C == e->type);
+		assert(NULL != e->text);
+		assert(e->textsz);
+	} else {
+		assert(d->instruct == 0);
+		e = decl_append(d);
+		e->type = DECLTYPE_C;
+	}
+
+	/*
+	 * We begin by seeing if there's a semicolon on this line.
+	 * If there is, we'll need to do some special handling.
+	 */
+	ep = strchr(cp, ';');
+	lcp = strchr(cp, '{');
+	rcp = strchr(cp, '}');
+
+	/* We're only a partial statement (i.e., no closure). */
+	if (ep == NULL && d->multiline) {
+		assert(e->text != NULL);
+		assert(e->textsz > 0);
+		/* Is a struct starting or ending here? */
+		if (d->instruct && NULL != rcp)
+			d->instruct--;
+		else if (NULL != lcp)
+			d->instruct++;
+		decl_function_add(p, &e->text, &e->textsz, cp, len);
+		return(1);
+	} else if (ep == NULL && !d->multiline) {
+		d->multiline = 1;
+		/* Is a structure starting in this line? */
+		if (NULL != lcp &&
+		    (rcp == NULL || rcp < lcp))
+			d->instruct++;
+		decl_function_copy(p, &e->text, &e->textsz, cp, len);
+		return(1);
+	}
+
+	/* Position ourselves after the semicolon. */
+	assert(NULL != ep);
+	ncp = cp;
+	nlen = (ep - cp) + 1;
+	cp = ep + 1;
+	len -= nlen;
+
+	if (d->multiline) {
+		assert(NULL != e->text);
+		/* Don't stop the multi-line if we're in a struct. */
+		if (d->instruct == 0) {
+			if (lcp == NULL || lcp > cp)
+				d->multiline = 0;
+		} else if (NULL != rcp && rcp < cp)
+			if (--d->instruct == 0)
+				d->multiline = 0;
+		decl_function_add(p, &e->text, &e->textsz, ncp, nlen);
+	} else {
+		assert(e->text == NULL);
+		if (NULL != lcp && lcp < cp) {
+			d->multiline = 1;
+			d->instruct++;
+		}
+		decl_function_copy(p, &e->text, &e->textsz, ncp, nlen);
+	}
+
+	goto again;
+}
+
+/*
+ * A definition is just #define followed by space followed by the name,
+ * then the value of that name.
+ * We ignore the latter.
+ * FIXME: this does not understand multi-line CPP, but I don't think
+ * there are any instances of that in sqlite3.h.
+ */
+static int
+decl_define(struct parse *p, const char *cp, size_t len)
+{
+	struct defn	*d;
+	struct decl	*e;
+	size_t		 sz;
+
+	while (isspace((unsigned char)*cp)) {
+		cp++;
+		len--;
+	}
+	if (len == 0) {
+		warnx("%s:%zu: empty pre-processor "
+			"constant", p->fn, p->ln);
+		return(1);
+	}
+
+	d = parse_last(p);
+
+	/*
+	 * We're parsing a preprocessor definition, but we're still
+	 * waiting on a semicolon from a function definition.
+	 * It might be a comment or an error.
+	 */
+	if (d->multiline) {
+		if (p->verbose)
+			warnx("%s:%zu: multiline declaration "
+				"still open", p->fn, p->ln);
+		e = decl_last(d);
+		e->type = DECLTYPE_NEITHER;
+		d->multiline = d->instruct = 0;
+	}
+
+	sz = 0;
+	while (cp[sz] != '\0' && !isspace((unsigned char)cp[sz]))
+		sz++;
+
+	e = decl_append(d);
+	e->type = DECLTYPE_CPP;
+	e->text = mem_calloc(MEM_PARSE, 1, sz + 1);
+	if (e->text == NULL)
+		err(1, NULL);
+	strlcpy(e->text, cp, sz + 1);
+	e->textsz = sz;
+	return(1);
+}
+
+/*
+ * A declaration is a function, variable, preprocessor definition, or
+ * really anything else until we reach a blank line.
+ */
+static void
+decl(struct parse *p, const char *cp, size_t len)
+{
+	struct defn	*d;
+	struct decl	*e;
+	const char	*oldcp;
+	size_t		 oldlen;
+
+	oldcp = cp;
+	oldlen = len;
+
+	while (isspace((unsigned char)*cp)) {
+		cp++;
+		len--;
+	}
+
+	d = parse_last(p);
+
+	/* Check closure. */
+	if (*cp == '\0') {
+		p->phase = PHASE_INIT;
+		/* Check multiline status. */
+		if (d->multiline) {
+			if (p->verbose)
+				warnx("%s:%zu: multiline declaration "
+					"still open", p->fn, p->ln);
+			e = decl_last(d);
+			e->type = DECLTYPE_NEITHER;
+			d->multiline = d->instruct = 0;
+		}
+		return;
+	}
+
+	d->fulldesc = mem_realloc(MEM_PARSE, d->fulldesc,
+		d->fulldescsz + oldlen + 2);
+	if (d->fulldesc == NULL)
+		err(1, NULL);
+	memcpy(d->fulldesc + d->fulldescsz, oldcp, oldlen);
+	d->fulldescsz += oldlen + 1;
+	d->fulldesc[d->fulldescsz - 1] = '\n';
+	d->fulldesc[d->fulldescsz] = '\0';
+	
+	/*
+	 * Catch preprocessor defines, but discard all other types of
+	 * preprocessor statements.
+	 * We might already be in the middle of a declaration (a
+	 * function declaration), but that's ok.
+	 */
+
+	if (*cp == '#') {
+		len--;
+		cp++;
+		while (isspace((unsigned char)*cp)) {
+			len--;
+			cp++;
+		}
+		if (strncmp(cp, "define", 6) == 0)
+			decl_define(p, cp + 6, len - 6);
+		return;
+	}
+
+	/* Skip one-liner comments. */
+
+	if (len > 4 &&
+	    cp[0] == '/' && cp[1] == '*' &&
+	    cp[len - 2] == '*' && cp[len - 1] == '/')
+		return;
+
+	decl_function(p, cp, len);
+}
+
+/*
+ * Whether to end an interface description phase with an asterisk-slash.
+ * This is run within a phase already opened with slash-asterisk.  It
+ * adjusts the parse state on ending a phase or syntax errors.  It has
+ * various hacks around lacks syntax (e.g., starting single-asterisk
+ * instead of double-asterisk) found in the wild.
+ *
+ * Returns zero if not ending the phase, non-zero if ending.
+ */
+static int
+endphase(struct parse *p, const char *cp)
+{
+
+	if (*cp == '\0') {
+		/*
+		 * Error: empty line.
+		 */
+		warnx("%s:%zu: warn: unexpected empty line in "
+			"interface description", p->fn, p->ln);
+		p->phase = PHASE_INIT;
+		return 1;
+	} else if (strcmp(cp, "*/") == 0) {
+		/*
+		 * End of the interface description.
+		 */
+		p->phase = PHASE_DECL;
+		return 1;
+	} else if (!(cp[0] == '*' && cp[1] == '*')) {
+		/*
+		 * Error: bad syntax, not end or continuation.
+		 */
+		if (cp[0] == '*' && cp[1] == '\0') {
+			if (p->verbose)
+				warnx("%s:%zu: warn: ignoring "
+					"standalone asterisk "
+					"in interface description",
+					p->fn, p->ln);
+			return 0;
+		} else if (cp[0] == '*' && cp[1] == ' ') {
+			if (p->verbose)
+				warnx("%s:%zu: warn: ignoring "
+					"leading single asterisk "
+					"in interface description",
+					p->fn, p->ln);
+			return 0;
+		}
+		warnx("%s:%zu: warn: ambiguous leading characters in "
+			"interface description", p->fn, p->ln);
+		p->phase = PHASE_INIT;
+		return 1;
+	}
+
+	/* If here, at a continuation ('**'). */
+
+	return 0;
+}
+
+/*
+ * Parse a "SEE ALSO" phase, which can come at any point in the
+ * interface description (unlike what they claim).
+ */
+static void
+seealso(struct parse *p, const char *cp, size_t len)
+{
+	struct defn	*d;
+
+	if (endphase(p, cp) || len < 2)
+		return;
+
+	cp += 2;
+	len -= 2;
+
+	while (isspace((unsigned char)*cp)) {
+		cp++;
+		len--;
+	}
+
+	/* Blank line: back to description part. */
+	if (len == 0) {
+		p->phase = PHASE_DESC;
+		return;
+	}
+
+	/* Fetch current interface definition. */
+	d = parse_last(p);
+
+	d->seealso = mem_realloc(MEM_PARSE, d->seealso,
+		d->seealsosz + len + 1);
+	memcpy(d->seealso + d->seealsosz, cp, len);
+	d->seealsosz += len;
+	d->seealso[d->seealsosz] = '\0';
+}
+
+/*
+ * Append "sz" bytes at "cp" to the description being parsed.
+ * If filtering, this goes into the parse's own buffer, which is reused
+ * for each definition, until desc_flush() knows whether the definition
+ * is wanted at all.
+ */
+static void
+desc_append(struct parse *p, const char *cp, size_t sz)
+{
+	struct defn	*d;
+	size_t		 max;
+	void		*pp;
+
+	if (p->filter == NULL) {
+		d = parse_last(p);
+		d->desc = mem_realloc(MEM_PARSE,
+			d->desc, d->descsz + sz + 1);
+		if (d->desc == NULL)
+			err(1, NULL);
+		memcpy(d->desc + d->descsz, cp, sz);
+		d->descsz += sz;
+		d->desc[d->descsz] = '\0';
+		return;
+	}
+
+	if (p->descsz + sz + 1 > p->descmax) {
+		max = p->descmax == 0 ? 1024 : p->descmax;
+		while (max < p->descsz + sz + 1)
+			max *= 2;
+		if ((pp = mem_realloc(MEM_PARSE, p->desc, max)) == NULL)
+			err(1, NULL);
+		p->desc = pp;
+		p->descmax = max;
+	}
+	memcpy(p->desc + p->descsz, cp, sz);
+	p->descsz += sz;
+	p->desc[p->descsz] = '\0';
+}
+
+/*
+ * A definition description is a block of text that we'll later format
+ * in mdoc(7).
+ * It extends from the name of the definition down to the declarations
+ * themselves.
+ */
+static void
+desc(struct parse *p, const char *cp, size_t len)
+{
+	struct defn	*d;
+	const char	*text;
+	size_t		 textsz;
+
+	if (endphase(p, cp) || len < 2)
+		return;
+
+	cp += 2;
+	len -= 2;
+
+	while (isspace((unsigned char)*cp)) {
+		cp++;
+		len--;
+	}
+
+	/* Fetch current interface definition and its text so far. */
+
+	d = parse_last(p);
+	text = p->filter != NULL ? p->desc : d->desc;
+	textsz = p->filter != NULL ? p->descsz : d->descsz;
+
+	/* Ignore leading blank lines. */
+
+	if (len == 0 && textsz == 0)
+		return;
+
+	/* Collect SEE ALSO clauses. */
+
+	if (strncasecmp(cp, "see also:", 9) == 0) {
+		cp += 9;
+		len -= 9;
+		while (isspace((unsigned char)*cp)) {
+			cp++;
+			len--;
+		}
+		p->phase = PHASE_SEEALSO;
+		d->seealso = mem_realloc(MEM_PARSE, d->seealso,
+			d->seealsosz + len + 1);
+		memcpy(d->seealso + d->seealsosz, cp, len);
+		d->seealsosz += len;
+		d->seealso[d->seealsosz] = '\0';
+		return;
+	}
+
+	/* White-space padding between lines. */
+
+	if (textsz > 0 &&
+	    text[textsz - 1] != ' ' &&
+	    text[textsz - 1] != '\n')
+		desc_append(p, " ", 1);
+
+	/* Either append the line of a newline, if blank. */
+
+	if (len == 0)
+		desc_append(p, "\n", 1);
+	else
+		desc_append(p, cp, len);
+}
+
+/*
+ * Copy all KEYWORDS into a buffer.
+ */
+static void
+keys(struct parse *p, const char *cp, size_t len)
+{
+	struct defn	*d;
+
+	if (endphase(p, cp) || len < 2)
+		return;
+
+	cp += 2;
+	len -= 2;
+	while (isspace((unsigned char)*cp)) {
+		cp++;
+		len--;
+	}
+
+	if (len == 0) {
+		p->phase = PHASE_DESC;
+		return;
+	} else if (strncmp(cp, "KEYWORDS:", 9))
+		return;
+
+	cp += 9;
+	len -= 9;
+
+	d = parse_last(p);
+	d->keybuf = mem_realloc(MEM_PARSE, d->keybuf, d->keybufsz + len + 1);
+	if (d->keybuf == NULL)
+		err(1, NULL);
+	memcpy(d->keybuf + d->keybufsz, cp, len);
+	d->keybufsz += len;
+	d->keybuf[d->keybufsz] = '\0';
+}
+
+/*
+ * Initial state is where we're scanning forward to find commented
+ * instances of CAPI3REF.
+ */
+static void
+init(struct parse *p, const char *cp)
+{
+	struct defn	*d;
+	size_t		 i, sz;
+	void		*pp;
+
+	/* Look for comment hook. */
+
+	if (cp[0] != '*' || cp[1] != '*')
+		return;
+	cp += 2;
+	while (isspace((unsigned char)*cp))
+		cp++;
+
+	/* Look for beginning of definition. */
+
+	if (strncmp(cp, "CAPI3REF:", 9))
+		return;
+	cp += 9;
+	while (isspace((unsigned char)*cp))
+		cp++;
+	if (*cp == '\0') {
+		warnx("%s:%zu: warn: unexpected end of "
+			"interface definition", p->fn, p->ln);
+		return;
+	}
+
+	/* Add definition to list of existing ones, keeping a zeroed one. */
+
+	if (p->defsz + 2 > p->defmax) {
+		pp = mem_reallocarray(MEM_PARSE, p->defs,
+			p->defmax * 2 + 2, sizeof(struct defn));
+		if (pp == NULL)
+			err(1, NULL);
+		p->defs = pp;
+		p->defmax = p->defmax * 2 + 2;
+	}
+	d = &p->defs[p->defsz++];
+	memset(d, 0, 2 * sizeof(struct defn));
+	if ((d->name = mem_strdup(MEM_PARSE, cp)) == NULL)
+		err(1, NULL);
+
+	/* Strip trailing spaces and periods. */
+
+	for (sz = strlen(d->name); sz > 0; sz--)
+		if (d->name[sz - 1] == '.' ||
+		    d->name[sz - 1] == ' ')
+			d->name[sz - 1] = '\0';
+		else
+			break;
+
+	/*
+	 * Un-title case.  Use a simple heuristic where all words
+	 * starting with an upper case letter followed by a not
+	 * uppercase letter are lowercased.
+	 */
+
+	for (i = 0; sz > 0 && i < sz - 1; i++)
+		if ((i == 0 || d->name[i - 1] == ' ') &&
+		    isupper((unsigned char)d->name[i]) &&
+		    !isupper((unsigned char)d->name[i + 1]) &&
+		    !ispunct((unsigned char)d->name[i + 1]))
+			d->name[i] = tolower((unsigned char)d->name[i]);
+
+	d->fn = p->fn;
+	d->ln = p->ln;
+	d->keytab = &p->keys;
+	d->strtab = &p->strs;
+	d->filter = p->filter;
+	p->phase = PHASE_KEYS;
+}
+
+#define	BPOINT(_cp) \
+	(';' == (_cp)[0] || \
+	 '[' == (_cp)[0] || \
+	 ('(' == (_cp)[0] && '*' != (_cp)[1]) || \
+	 ')' == (_cp)[0] || \
+	 '{' == (_cp)[0])
+
+/*
+ * Given a declaration (be it preprocessor or C), try to parse out a
+ * reasonable "name" for the affair.
+ * For a struct, for example, it'd be the struct name.
+ * For a typedef, it'd be the type name.
+ * For a function, it'd be the function name.
+ */
+static void
+grok_name(const struct decl *e,
+	const char **start, size_t *sz)
+{
+	const char	*cp;
+
+	*start = NULL;
+	*sz = 0;
+
+	if (DECLTYPE_CPP != e->type) {
+		if (e->text[e->textsz - 1] != ';')
+			return;
+		cp = e->text;
+		do {
+			while (isspace((unsigned char)*cp))
+				cp++;
+			if (BPOINT(cp))
+				break;
+			/* Function pointers... */
+			if (*cp == '(')
+				cp++;
+			/* Pass over pointers. */
+			while (*cp == '*')
+				cp++;
+			*start = cp;
+			*sz = 0;
+			while (!isspace((unsigned char)*cp)) {
+				if (BPOINT(cp))
+					break;
+				cp++;
+				(*sz)++;
+			}
+		} while (!BPOINT(cp));
+	} else {
+		*sz = e->textsz;
+		*start = e->text;
+	}
+}
+
+/*
+ * Strip unknown tokens out of the description.  "Unknown" consists of
+ * things that mess up parsing of the HTML, for instance:
+ *
+ *     <dl>[[foo bar]]<dt>foo bar</dt>...</dl>
+ *
+ * These are not well-formed HTML.  Note that d->desc[d->descz] is the
+ * NUL terminator, so we don't need to check d->descsz - 1.
+ * This is done once, as all output formats need it.
+ */
+static void
+desc_strip(struct defn *d)
+{
+	size_t	 descsz, i, j;
+
+	descsz = d->descsz;
+	for (i = 0; i < descsz; ) {
+		if (d->desc[i] == '^' &&
+		    d->desc[i + 1] == '(') {
+			memmove(&d->desc[i],
+				&d->desc[i + 2],
+				descsz - i - 1);
+			descsz -= 2;
+			continue;
+		} else if (d->desc[i] == ')' &&
+			   d->desc[i + 1] == '^') {
+			memmove(&d->desc[i],
+				&d->desc[i + 2],
+				descsz - i - 1);
+			descsz -= 2;
+			continue;
+		} else if (d->desc[i] == '^') {
+			memmove(&d->desc[i],
+				&d->desc[i + 1],
+				descsz - i);
+			descsz -= 1;
+			continue;
+		} else if (d->desc[i] != '[' ||
+			   d->desc[i + 1] != '[') {
+			i++;
+			continue;
+		}
+
+		for (j = i; j < descsz; j++)
+			if (d->desc[j] == ']' &&
+			    d->desc[j + 1] == ']')
+				break;
+
+		/* Ignore if we don't have a terminator. */
+
+		assert(j > i);
+		j += 2;
+		if (j > descsz) {
+			i++;
+			continue;
+		}
+
+		memmove(&d->desc[i], &d->desc[j], descsz - j + 1);
+		descsz -= (j - i);
+	}
+
+	d->descsz = descsz;
+}
+
+/*
+ * Whether any name or keyword matches the filter, a glob(7) pattern.
+ */
+static int
+filter_match(const struct defn *d)
+{
+	size_t	 i;
+
+	for (i = 0; i < d->nmsz; i++)
+		if (fnmatch(d->filter, d->nms[i], 0) == 0)
+			return 1;
+	for (i = 0; i < d->keysz; i++)
+		if (fnmatch(d->filter, d->keys[i], 0) == 0)
+			return 1;
+	return 0;
+}
+
+/*
+ * Find the next keyword in the raw keywords "buf" from "*pos", which is
+ * either a braced phrase or a word.
+ * Returns zero if there are no more.
+ */
+static int
+key_next(const char *buf, size_t bufsz, size_t *pos,
+	const char **start, size_t *sz)
+{
+	size_t	 i = *pos;
+
+	do {
+		while (i < bufsz && isspace((unsigned char)buf[i]))
+			i++;
+		if (i == bufsz) {
+			*pos = i;
+			return 0;
+		}
+		*sz = 0;
+		*start = &buf[i];
+		if (buf[i] == '{') {
+			*start = &buf[++i];
+			for ( ; i < bufsz; i++, (*sz)++)
+				if (buf[i] == '}')
+					break;
+			if (i < bufsz && buf[i] == '}')
+				i++;
+		} else
+			for ( ; i < bufsz; i++, (*sz)++)
+				if (isspace((unsigned char)buf[i]))
+					break;
+	} while (*sz == 0);
+
+	*pos = i;
+	return 1;
+}
+
+/*
+ * Like filter_match(), but for a definition whose names and keywords
+ * haven't yet been extracted.
+ */
+static int
+filter_match_raw(const struct defn *d)
+{
+	const struct decl	*e;
+	const char		*start;
+	char			*cp;
+	size_t			 sz, i = 0;
+	int			 rc = 0;
+
+	for (e = d->decls; !rc && e < d->decls + d->declsz; e++) {
+		if (DECLTYPE_CPP != e->type && DECLTYPE_C != e->type)
+			continue;
+		grok_name(e, &start, &sz);
+		if (start == NULL)
+			continue;
+		if ((cp = mem_strndup(MEM_PARSE, start, sz)) == NULL)
+			err(1, NULL);
+		rc = fnmatch(d->filter, cp, 0) == 0;
+		mem_free(cp);
+	}
+	while (!rc && key_next(d->keybuf, d->keybufsz, &i, &start, &sz)) {
+		if ((cp = mem_strndup(MEM_PARSE, start, sz)) == NULL)
+			err(1, NULL);
+		rc = fnmatch(d->filter, cp, 0) == 0;
+		mem_free(cp);
+	}
+	return rc;
+}
+
+/*
+ * If filtering, the description of the last definition is pending in
+ * the parse until the definition is complete, as names come from its
+ * declarations.
+ * Give it to the definition if wanted and drop it otherwise, along with
+ * the SEE ALSO text.
+ */
+static void
+desc_flush(struct parse *p)
+{
+	struct defn	*d;
+
+	if (p->filter == NULL || p->defsz == 0 || p->descsz == 0)
+		return;
+	d = parse_last(p);
+	if (filter_match_raw(d)) {
+		d->desc = mem_strndup(MEM_PARSE, p->desc, p->descsz);
+		if (d->desc == NULL)
+			err(1, NULL);
+		d->descsz = p->descsz;
+	} else {
+		mem_free(d->seealso);
+		d->seealso = NULL;
+		d->seealsosz = 0;
+	}
+	p->descsz = 0;
+}
+
+/*
+ * Extract information from the interface definition.
+ * Mark it as "postprocessed" on success.
+ */
+void
+parse_postprocess(struct defn *d, const char *suffix)
+{
+	struct decl	*first;
+	const char	*start;
+	size_t		 sz, i;
+
+	if (d->declsz == 0)
+		return;
+
+	/* Find the first #define or declaration. */
+
+	for (i = 0; i < d->declsz; i++)
+		if (DECLTYPE_CPP == d->decls[i].type ||
+		    DECLTYPE_C == d->decls[i].type)
+			break;
+
+	if (i == d->declsz) {
+		warnx("%s:%zu: no entry to document", d->fn, d->ln);
+		return;
+	}
+	first = &d->decls[i];
+
+	/*
+	 * Now compute the document name (`Dt').
+	 * We'll also use this for the filename.
+	 */
+
+	grok_name(first, &start, &sz);
+	if (start == NULL) {
+		warnx("%s:%zu: couldn't deduce "
+			"entry name", d->fn, d->ln);
+		return;
+	}
+
+	/* Document name needs all-caps. */
+
+	if ((d->dt = mem_strndup(MEM_POSTPROCESS, start, sz)) == NULL)
+		err(1, NULL);
+	sz = strlen(d->dt);
+	for (i = 0; i < sz; i++)
+		d->dt[i] = toupper((unsigned char)d->dt[i]);
+
+	/*
+	 * Filename needs no special chars.
+	 * It's relative to the output directory, which is only opened
+	 * once, so don't bother carrying the prefix around.
+	 */
+
+	if (mem_asprintf(MEM_POSTPROCESS, &d->fname,
+	    "%.*s%s", (int)sz, start, suffix) == -1)
+		err(1, NULL);
+
+	for (i = 0; i < sz; i++) {
+		if (isalnum((unsigned char)d->fname[i]) ||
+		    d->fname[i] == '_' ||
+		    d->fname[i] == '-')
+			continue;
+		d->fname[i] = '_';
+	}
+
+	/*
+	 * First, extract all keywords.
+	 */
+	i = 0;
+	while (key_next(d->keybuf, d->keybufsz, &i, &start, &sz)) {
+		d->keys = mem_reallocarray(MEM_POSTPROCESS, d->keys,
+			d->keysz + 1, sizeof(const char *));
+		if (d->keys == NULL)
+			err(1, NULL);
+		d->keys[d->keysz++] =
+			strtab_intern(d->strtab, start, sz);
+		
+		/* Hash the keyword. */
+		keytab_insert(d->keytab, d->keys[d->keysz - 1], d);
+		if (stats != NULL)
+			stats->hinserts++;
+	}
+
+	/*
+	 * Now extract all `Nm' values for this document.
+	 * We only use CPP and C references, and hope for the best when
+	 * doing so.
+	 * Enter each one of these as a searchable keyword.
+	 */
+	for (first = d->decls; first < d->decls + d->declsz; first++) {
+		if (DECLTYPE_CPP != first->type &&
+		    DECLTYPE_C != first->type)
+			continue;
+		grok_name(first, &start, &sz);
+		if (start == NULL)
+			continue;
+		d->nms = mem_reallocarray(MEM_POSTPROCESS, d->nms,
+			d->nmsz + 1, sizeof(const char *));
+		if (d->nms == NULL)
+			err(1, NULL);
+		d->nms[d->nmsz++] =
+			strtab_intern(d->strtab, start, sz);
+
+		/* Hash the name. */
+		keytab_insert(d->keytab, d->nms[d->nmsz - 1], d);
+		if (stats != NULL)
+			stats->hinserts++;
+	}
+
+	if (d->nmsz == 0) {
+		warnx("%s:%zu: couldn't deduce "
+			"any names", d->fn, d->ln);
+		return;
+	}
+
+	/*
+	 * If filtering, the names and keywords are still needed to
+	 * resolve references from other pages, but nothing else is.
+	 */
+
+	if (d->filter != NULL && !filter_match(d)) {
+		d->filtered = 1;
+		mem_free(d->desc);
+		mem_free(d->seealso);
+		d->desc = d->seealso = NULL;
+		d->descsz = d->seealsosz = 0;
+		return;
+	}
+
+	/*
+	 * Next, scan for all `Xr' values.
+	 * We'll add more to this list later.
+	 */
+	for (i = 0; i < d->seealsosz; i++) {
+		/*
+		 * Find next value starting with `['.
+		 * There's other stuff in there (whitespace or
+		 * free text leading up to these) that we're ok
+		 * to ignore.
+		 */
+		while (i < d->seealsosz && d->seealso[i] != '[')
+			i++;
+		if (i == d->seealsosz)
+			break;
+
+		/*
+		 * Now scan for the matching `]'.
+		 * We can also have a vertical bar if we're separating a
+		 * keyword and its shown name.
+		 */
+		start = &d->seealso[++i];
+		sz = 0;
+		while (i < d->seealsosz &&
+		      d->seealso[i] != ']' &&
+		      d->seealso[i] != '|') {
+			i++;
+			sz++;
+		}
+		if (i == d->seealsosz)
+			break;
+		if (sz == 0)
+			continue;
+
+		/*
+		 * Continue on to the end-of-reference, if we weren't
+		 * there to begin with.
+		 */
+		if (d->seealso[i] != ']')
+			while (i < d->seealsosz &&
+			      d->seealso[i] != ']')
+				i++;
+
+		/* Strip trailing whitespace. */
+		while (sz > 1 && start[sz - 1] == ' ')
+			sz--;
+
+		/* Strip trailing parenthesis. */
+		if (sz > 2 &&
+		    start[sz - 2] == '(' &&
+	 	    start[sz - 1] == ')')
+			sz -= 2;
+
+		d->xrs = mem_reallocarray(MEM_POSTPROCESS, d->xrs,
+			d->xrsz + 1, sizeof(const char *));
+		if (d->xrs == NULL)
+			err(1, NULL);
+		d->xrs[d->xrsz++] =
+			strtab_intern(d->strtab, start, sz);
+	}
+
+	/*
+	 * Next, extract all references.
+	 * We'll accumulate these into a list of SEE ALSO tags, after.
+	 * See how these are parsed above for a description: this is
+	 * basically the same thing.
+	 */
+	for (i = 0; i < d->descsz; i++) {
+		if (d->desc[i] != '[')
+			continue;
+		i++;
+		if (d->desc[i] == '[')
+			continue;
+
+		start = &d->desc[i];
+		for (sz = 0; i < d->descsz; i++, sz++)
+			if (d->desc[i] == ']' ||
+			    d->desc[i] == '|')
+				break;
+
+		if (i == d->descsz)
+			break;
+		else if (sz == 0)
+			continue;
+
+		if (d->desc[i] != ']')
+			while (i < d->descsz && d->desc[i] != ']')
+				i++;
+
+		while (sz > 1 && start[sz - 1] == ' ')
+			sz--;
+
+		if (sz > 2 &&
+		    start[sz - 2] == '(' &&
+		    start[sz - 1] == ')')
+			sz -= 2;
+
+		d->xrs = mem_reallocarray(MEM_POSTPROCESS, d->xrs,
+			d->xrsz + 1, sizeof(const char *));
+		if (d->xrs == NULL)
+			err(1, NULL);
+		d->xrs[d->xrsz++] =
+			strtab_intern(d->strtab, start, sz);
+	}
+
+	desc_strip(d);
+	d->postprocessed = 1;
+}
+
+/*
+ * Process a single line of input, which must be NUL-terminated and
+ * stripped of its trailing newline, in the phase dictated by our
+ * finite state automaton.
+ */
+void
+parse_line(struct parse *p, const char *cp, size_t len)
+{
+
+	switch (p->phase) {
+	case PHASE_INIT:
+		desc_flush(p);
+		init(p, cp);
+		break;
+	case PHASE_KEYS:
+		keys(p, cp, len);
+		break;
+	case PHASE_DESC:
+		desc(p, cp, len);
+		break;
+	case PHASE_SEEALSO:
+		seealso(p, cp, len);
+		break;
+	case PHASE_DECL:
+		decl(p, cp, len);
+		break;
+	}
+}
+
+/*
+ * Initialise the parse for the given filename, used in reporting.
+ */
+void
+parse_init(struct parse *p, const char *fn)
+{
+
+	memset(p, 0, sizeof(struct parse));
+	p->fn = fn;
+	p->phase = PHASE_INIT;
+}
+
+/*
+ * Parse all lines of the "sz" bytes at "buf".
+ * The final line need not be newline-terminated and lines are cut at
+ * any NUL byte.
+ */
+void
+parse_buf(struct parse *p, const char *buf, size_t sz)
+{
+	const char	*cp, *end;
+	char		*ln = NULL;
+	size_t		 len, lnsz = 0;
+
+	for (cp = buf; cp < buf + sz; cp = end + 1) {
+		if ((end = memchr(cp, '\n', buf + sz - cp)) == NULL)
+			end = buf + sz;
+		len = end - cp;
+		if (len + 1 > lnsz) {
+			lnsz = len + 1;
+			if ((ln = mem_realloc(MEM_PARSE, ln, lnsz)) == NULL)
+				err(1, NULL);
+		}
+		memcpy(ln, cp, len);
+		ln[len] = '\0';
+		p->ln++;
+		parse_line(p, ln, strlen(ln));
+	}
+	mem_free(ln);
+}
+
+/*
+ * Finish the parse at the current line, which we're allowed to end at
+ * the declarations or scanning for the next clause.
+ * Returns zero (with a warning) if not, non-zero if so.
+ */
+int
+parse_finish(struct parse *p)
+{
+
+	desc_flush(p);
+	if (p->phase == PHASE_INIT || p->phase == PHASE_DECL)
+		return 1;
+	warnx("%s:%zu: exit when not in initial state", p->fn, p->ln);
+	return 0;
+}
+
+/*
+ * Free all definitions and their declarations.
+ * The parse may be reused after a parse_init().
+ */
+void
+parse_free(struct parse *p)
+{
+	struct defn	*d;
+	size_t		 i;
+
+	for (d = p->defs; d < p->defs + p->defsz; d++) {
+		for (i = 0; i < d->declsz; i++)
+			mem_free(d->decls[i].text);
+		mem_free(d->decls);
+		mem_free(d->name);
+		mem_free(d->desc);
+		mem_free(d->fulldesc);
+		mem_free(d->dt);
+		mem_free(d->keys);
+		mem_free(d->nms);
+		mem_free(d->xrs);
+		mem_free(d->rxs);
+		mem_free(d->fname);
+		mem_free(d->seealso);
+		mem_free(d->keybuf);
+	}
+	mem_free(p->defs);
+	p->defs = NULL;
+	p->defsz = p->defmax = 0;
+	keytab_free(&p->keys);
+	strtab_free(&p->strs);
+	mem_free(p->desc);
+	p->desc = NULL;
+	p->descsz = p->descmax = 0;
+}
+
+/*
+ * Move the parse "src" into "dst", leaving "src" empty.
+ * Definitions refer to the string table (and possibly keyword table)
+ * of their parse, so these are pointed at "dst".
+ */
+void
+parse_move(struct parse *dst, struct parse *src)
+{
+	struct defn	*d;
+
+	*dst = *src;
+	for (d = dst->defs; d < dst->defs + dst->defsz; d++) {
+		d->strtab = &dst->strs;
+		if (d->keytab == &src->keys)
+			d->keytab = &dst->keys;
+	}
+	memset(src, 0, sizeof(struct parse));
+}
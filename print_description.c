@@ -29,36 +29,6 @@
 
 #include "extern.h"
 
-enum tag {
-	TAG_A,
-	TAG_B,
-	TAG_BLOCK,
-	TAG_BR,
-	TAG_DD,
-	TAG_DL,
-	TAG_DT,
-	TAG_EM,
-	TAG_H3,
-	TAG_I,
-	TAG_LI,
-	TAG_OL,
-	TAG_P,
-	TAG_PRE,
-	TAG_SPAN,
-	TAG_TABLE,
-	TAG_TD,
-	TAG_TH,
-	TAG_TR,
-	TAG_U,
-	TAG_UL,
-	TAG__MAX,
-};
-
-enum attr {
-	ATTR_HREF,
-	ATTR__MAX,
-};
-
 /*
  * How to handle mdoc(7) replacement content for HTML found in the text.
  */
@@ -98,34 +68,6 @@ static const struct taginfo tags[TAG__MAX] = {
 	{ ".Bl -bullet", ".El\n.Pp", 0, 0 }, /* TAG_UL */
 };
 
-static const char *tagnames[TAG__MAX] = {
-	"a", /* TAG_A */
-	"b", /* TAG_B */
-	"blockquote", /* TAG_BLOCK */
-	"br", /* TAG_BR */
-	"dd", /* TAG_DD */
-	"dl", /* TAG_DL */
-	"dt", /* TAG_DT */
-	"em", /* TAG_EM */
-	"h3", /* TAG_H3 */
-	"i", /* TAG_I */
-	"li", /* TAG_LI */
-	"ol", /* TAG_OL */
-	"p", /* TAG_P */
-	"pre", /* TAG_PRE */
-	"span", /* TAG_SPAN */
-	"table", /* TAG_TABLE */
-	"td", /* TAG_TD */
-	"th", /* TAG_TH */
-	"tr", /* TAG_TR */
-	"u", /* TAG_U */
-	"ul", /* TAG_UL */
-};
-
-static const char *attrs[ATTR__MAX] = {
-	"href", /* ATTR_HREF */
-};
-
 struct entityinfo {
 	const char	*html; /* HTML entity w/o amp/semicolon */
 	const char	*mdoc; /* replacement mdoc(7) */
@@ -146,134 +88,6 @@ static const struct entityinfo entities[] = {
 	{ NULL, NULL },
 };
 
-static enum tag
-parse_tags(const char *in, size_t *outpos, const char **outattrs,
-    size_t *outattrsz, int *close)
-{
-	enum tag	 tag;
-	enum attr	 attr;
-	size_t		 sz;
-	const char	*start = in;
-
-	/* Initialise to zero/NULL. */
-
-	if (outpos != NULL)
-		*outpos = 0;
-	for (attr = 0; attr < ATTR__MAX; attr++) {
-		if (outattrs != NULL)
-			outattrs[attr] = NULL;
-		if (outattrsz != NULL)
-			outattrsz[attr] = 0;
-	}
-
-	/* Only scan if starting with the tag delimiter. */
-
-	if (*in++ != '<')
-		return TAG__MAX;
-
-	/* Check for closing delimiter. */
-
-	if (*in == '/') {
-		if (close != NULL)
-			*close = 1;
-		in++;
-	} else if (close != NULL)
-		*close = 0;
-
-	/*
-	 * Find the tag, which must be normatively formatted as either
-	 * "<tag " or "<tag>".  Sets "tag", if found; otherwise, "tag"
-	 * will be set to TAG__MAX on exiting the loop.
-	 */
-
-	for (tag = 0; tag < TAG__MAX; tag++) {
-		sz = strlen(tagnames[tag]);
-		assert(sz > 0);
-		if (strncmp(in, tagnames[tag], sz) == 0 &&
-		    (in[sz] == ' ' || in[sz] == '>')) {
-			in += sz;
-			break;
-		}
-	}
-	
-	if (tag == TAG__MAX)
-		return tag;
-
-	/*
-	 * Find any registered attributes until the closing delimiter.
-	 * If the tag in general is malformed (e.g., unexpected NUL),
-	 * then bail early by returning TAG__MAX.
-	 */
-
-	assert(*in == ' ' || *in == '>');
-	assert(tag != TAG__MAX);
-
-	while (isspace((unsigned char)*in))
-		in++;
-
-	while (*in != '>') {
-		for (attr = 0; attr < ATTR__MAX; attr++) {
-			sz = strlen(attrs[attr]);
-			if (strncmp(in, attrs[attr], sz) == 0 &&
-			    in[sz] == '=')
-				break;
-		}
-
-		if (attr == ATTR__MAX) {
-			for (sz = 0; in[sz] != '\0'; sz++)
-				if (in[sz] == '=')
-					break;
-			if (in[sz] == '\0')
-				return TAG__MAX;
-		}
-
-		/*
-		 * Handle both quoted and unquoted.  Bail out with
-		 * TAG__MAX if NUL is encountered.
-		 */
-
-		if (in[++sz] == '"') {
-			sz++;
-			if (attr != ATTR__MAX && outattrs != NULL)
-				outattrs[attr] = &in[sz];
-			for ( ; in[sz] != '\0'; sz++) {
-				if (in[sz] == '"')
-					break;
-				if (attr != ATTR__MAX &&
-				    outattrsz != NULL)
-					outattrsz[attr]++;
-			}
-			if (in[sz] == '\0')
-				return TAG__MAX;
-			assert(in[sz] == '"');
-			sz++;
-		} else {
-			if (attr != ATTR__MAX && outattrs != NULL)
-				outattrs[attr] = &in[sz];
-			for (; in[sz] != '\0'; sz++) {
-				if (in[sz] == ' ' ||
-				    in[sz] == '>')
-					break;
-				if (attr != ATTR__MAX &&
-				    outattrsz != NULL)
-					outattrsz[attr]++;
-			}
-			if (in[sz] == '\0')
-				return TAG__MAX;
-		}
-		in += sz;
-
-		/* Remove trailing spaces. */
-
-		while (isspace((unsigned char)*in))
-			in++;
-	}
-
-	assert(*in == '>');
-	if (outpos != NULL)
-		*outpos = (size_t)(++in - start);
-	return tag;
-}
 
 /*
  * Return non-zero if "new sentence, new line" is in effect, zero
@@ -349,7 +163,7 @@ table_columns(const char *buf, size_t len)
 }
 
 void
-print_description(FILE *f, const struct defn *d)
+print_description(struct buf *b, const struct defn *d)
 {
 	size_t		 sz, descsz, i, j, col, stripspace, outpos;
 	enum tag	 tag;
@@ -359,63 +173,7 @@ print_description(FILE *f, const struct defn *d)
 	size_t		 attrsz[ATTR__MAX];
 	unsigned int	 flags;
 
-	/*
-	 * Strip unknown tokens out of the description.  "Unknown"
-	 * consists of things that mess up parsing of the HTML,
-	 * for instance:
-	 *
-	 *     <dl>[[foo bar]]<dt>foo bar</dt>...</dl>
-	 *
-	 * These are not well-formed HTML.  Note that d->desc[d->descz]
-	 * is the NUL terminator, so we don't need to check d->descsz -
-	 * 1.
-	 */
-
 	descsz = d->descsz;
-	for (i = 0; i < descsz; ) {
-		if (d->desc[i] == '^' &&
-		    d->desc[i + 1] == '(') {
-			memmove(&d->desc[i],
-				&d->desc[i + 2],
-				descsz - i - 1);
-			descsz -= 2;
-			continue;
-		} else if (d->desc[i] == ')' &&
-			   d->desc[i + 1] == '^') {
-			memmove(&d->desc[i],
-				&d->desc[i + 2],
-				descsz - i - 1);
-			descsz -= 2;
-			continue;
-		} else if (d->desc[i] == '^') {
-			memmove(&d->desc[i],
-				&d->desc[i + 1],
-				descsz - i);
-			descsz -= 1;
-			continue;
-		} else if (d->desc[i] != '[' ||
-			   d->desc[i + 1] != '[') {
-			i++;
-			continue;
-		}
-
-		for (j = i; j < descsz; j++)
-			if (d->desc[j] == ']' &&
-			    d->desc[j + 1] == ']')
-				break;
-
-		/* Ignore if we don't have a terminator. */
-
-		assert(j > i);
-		j += 2;
-		if (j > descsz) {
-			i++;
-			continue;
-		}
-
-		memmove(&d->desc[i], &d->desc[j], descsz - j + 1);
-		descsz -= (j - i);
-	}
 
 	/*
 	 * Here we go!
@@ -465,8 +223,8 @@ print_description(FILE *f, const struct defn *d)
 			    (!close &&
 			     (tags[tag].oflags & TAGINFO_INLINE))) {
 				if (col > 0)
-					fputs("\n", f);
-				fputs(".Pp\n", f);
+					buf_puts(b, "\n");
+				buf_puts(b, ".Pp\n");
 				/* We're on a new line. */
 				col = 0;
 			}
@@ -489,7 +247,7 @@ print_description(FILE *f, const struct defn *d)
 			if (newsentence(j, i, d->desc)) {
 				while (d->desc[i] == ' ')
 					i++;
-				fputc('\n', f);
+				buf_putc(b, '\n');
 				col = 0;
 				continue;
 			}
@@ -503,7 +261,7 @@ print_description(FILE *f, const struct defn *d)
 		if (col > 65 && d->desc[i] == ' ') {
 			while (d->desc[i] == ' ' )
 				i++;
-			fputc('\n', f);
+			buf_putc(b, '\n');
 			col = 0;
 			continue;
 		}
@@ -518,18 +276,18 @@ print_description(FILE *f, const struct defn *d)
 			switch (tag) {
 			case TAG_A:
 				if (close) {
-					fputs("\"\n", f);
+					buf_puts(b, "\"\n");
 					col = 0;
 					break;
 				}
 				if (col > 0)
-					fputs("\n", f);
-				fputs(".Lk ", f);
+					buf_puts(b, "\n");
+				buf_puts(b, ".Lk ");
 				if (attrsz[ATTR_HREF] > 0)
-					fprintf(f, "%.*s",
+					buf_printf(b, "%.*s",
 						(int)attrsz[ATTR_HREF],
 						attrs[ATTR_HREF]);
-				fputs(" \"", f);
+				buf_puts(b, " \"");
 				col = 1;
 				stripspace = 0;
 				break;
@@ -543,10 +301,10 @@ print_description(FILE *f, const struct defn *d)
 					break;
 				if (incolumn) {
 					if (col > 0)
-						fputs("\n", f);
-					fputs("T}\t", f);
+						buf_puts(b, "\n");
+					buf_puts(b, "T}\t");
 				}
-				fputs("T{\n", f);
+				buf_puts(b, "T{\n");
 				col = 0;
 				incolumn = 1;
 				break;
@@ -554,21 +312,21 @@ print_description(FILE *f, const struct defn *d)
 				if (close || !incolumn)
 					break;
 				if (col > 0)
-					fputs("\n", f);
-				fputs("T}\n", f);
+					buf_puts(b, "\n");
+				buf_puts(b, "T}\n");
 				col = 0;
 				incolumn = 0;
 				break;
 			case TAG_TABLE:
 				if (!close && !inblockquote) {
 					if (col > 0)
-						fputs("\n", f);
-					fputs(".sp\n", f);
+						buf_puts(b, "\n");
+					buf_puts(b, ".sp\n");
 					col = 0;
 				} else if (close && incolumn) {
 					if (col > 0)
-						fputs("\n", f);
-					fputs("T}\n", f);
+						buf_puts(b, "\n");
+					buf_puts(b, "T}\n");
 					col = 0;
 					incolumn = 0;
 				}
@@ -594,14 +352,14 @@ print_description(FILE *f, const struct defn *d)
 					i++;
 			} else if (flags == TAGINFO_INLINE) {
 				while (stripspace > 0) {
-					fputc(' ', f);
+					buf_putc(b, ' ');
 					col++;
 					stripspace--;
 				}
 				if (close)
-					fputs(tags[tag].cmdoc, f);
+					buf_puts(b, tags[tag].cmdoc);
 				else
-					fputs(tags[tag].omdoc, f);
+					buf_puts(b, tags[tag].omdoc);
 			} else {
 				/*
 				 * A breaking mdoc(7) statement.  Break
@@ -611,19 +369,19 @@ print_description(FILE *f, const struct defn *d)
 				 */
 
 				if (col > 0) {
-					fputs("\n", f);
+					buf_puts(b, "\n");
 					col = 0;
 				}
 
 				if (close)
-					fputs(tags[tag].cmdoc, f);
+					buf_puts(b, tags[tag].cmdoc);
 				else
-					fputs(tags[tag].omdoc, f);
+					buf_puts(b, tags[tag].omdoc);
 				if (!(flags & TAGINFO_NOBR)) {
-					fputs("\n", f);
+					buf_puts(b, "\n");
 					col = 0;
 				} else if (!(flags & TAGINFO_NOSP)) {
-					fputs(" ", f);
+					buf_puts(b, " ");
 					col++;
 				}
 				while (isspace((unsigned char)d->desc[i]))
@@ -631,7 +389,7 @@ print_description(FILE *f, const struct defn *d)
 
 				if (tag == TAG_TABLE && close) {
 					if (!inblockquote)
-						fputs(".sp\n", f);
+						buf_puts(b, ".sp\n");
 					col = 0;
 				}
 
@@ -649,9 +407,9 @@ print_description(FILE *f, const struct defn *d)
 					sz = table_columns(&d->desc[i],
 						descsz - i);
 					for (j = 0; j < sz; j++)
-						fprintf(f, "%sl", j > 0 ?
+						buf_printf(b, "%sl", j > 0 ?
 							" " : "");
-					fputs(".\n", f);
+					buf_puts(b, ".\n");
 				}
 			}
 
@@ -661,7 +419,7 @@ print_description(FILE *f, const struct defn *d)
 			/* Literal '<<' as in bit-shifting. */
 
 			while (stripspace > 0) {
-				fputc(' ', f);
+				buf_putc(b, ' ');
 				col++;
 				stripspace--;
 			}
@@ -697,17 +455,17 @@ print_description(FILE *f, const struct defn *d)
 				    d->desc[sz - 1] == ')' &&
 				    d->desc[sz - 2] == '(') {
 					if (col > 0)
-						fputc('\n', f);
-					fputs(".Fn ", f);
+						buf_putc(b, '\n');
+					buf_puts(b, ".Fn ");
 					j = sz - 2;
 					assert(j > 0);
 				} else if (stripspace) {
-					fputc(' ', f);
+					buf_putc(b, ' ');
 					col++;
 				}
 			} else {
 				if (stripspace) {
-					fputc(' ', f);
+					buf_putc(b, ' ');
 					col++;
 				}
 				i = sz + 1;
@@ -730,11 +488,11 @@ print_description(FILE *f, const struct defn *d)
 					i += 3;
 					for ( ; i < descsz; i++)
 						if (d->desc[i] == '.')
-							fputs(" .", f);
+							buf_puts(b, " .");
 						else if (d->desc[i] == ',')
-							fputs(" ,", f);
+							buf_puts(b, " ,");
 						else if (d->desc[i] == ')')
-							fputs(" )", f);
+							buf_puts(b, " )");
 						else
 							break;
 
@@ -744,14 +502,14 @@ print_description(FILE *f, const struct defn *d)
 					       isspace((unsigned char)d->desc[i]))
 						i++;	
 
-					fputc('\n', f);
+					buf_putc(b, '\n');
 					col = 0;
 					break;
 				} else if (d->desc[i] == ']') {
 					i++;
 					break;
 				}
-				fputc(d->desc[i], f);
+				buf_putc(b, d->desc[i]);
 				col++;
 			}
 
@@ -805,7 +563,7 @@ print_description(FILE *f, const struct defn *d)
 				if (d->desc[i + sz + 1] != ';')
 					continue;
 				assert(entities[j].mdoc != NULL);
-				fputs(entities[j].mdoc, f);
+				buf_puts(b, entities[j].mdoc);
 				found = 1;
 				i += sz + 2;
 				break;
@@ -817,13 +575,13 @@ print_description(FILE *f, const struct defn *d)
 			 */
 			if (col == 0 &&
 			    (d->desc[i] == '.' || d->desc[i] == '\''))
-				fputs("\\&", f);
-			fputc(d->desc[i], f);
+				buf_puts(b, "\\&");
+			buf_putc(b, d->desc[i]);
 			i++;
 		}
 		col++;
 	}
 
 	if (col > 0)
-		fputs("\n", f);
+		buf_puts(b, "\n");
 }
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#include <ctype.h>
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extern.h"
+
+/*
+ * Tags that don't start a new block: paragraph breaks before these are
+ * kept, while those before block tags are dropped.
+ */
+static const int inlines[TAG__MAX] = {
+	1, /* TAG_A */
+	1, /* TAG_B */
+	0, /* TAG_BLOCK */
+	1, /* TAG_BR */
+	0, /* TAG_DD */
+	0, /* TAG_DL */
+	0, /* TAG_DT */
+	1, /* TAG_EM */
+	0, /* TAG_H3 */
+	1, /* TAG_I */
+	0, /* TAG_LI */
+	0, /* TAG_OL */
+	0, /* TAG_P */
+	0, /* TAG_PRE */
+	1, /* TAG_SPAN */
+	0, /* TAG_TABLE */
+	0, /* TAG_TD */
+	0, /* TAG_TH */
+	0, /* TAG_TR */
+	1, /* TAG_U */
+	0, /* TAG_UL */
+};
+
+/*
+ * Write "sz" bytes of "cp" with HTML special characters escaped.
+ */
+static void
+html_escape(struct buf *b, const char *cp, size_t sz)
+{
+	size_t	 i;
+
+	for (i = 0; i < sz; i++)
+		switch (cp[i]) {
+		case '&':
+			buf_puts(b, "&amp;");
+			break;
+		case '<':
+			buf_puts(b, "&lt;");
+			break;
+		case '>':
+			buf_puts(b, "&gt;");
+			break;
+		case '"':
+			buf_puts(b, "&quot;");
+			break;
+		default:
+			buf_putc(b, cp[i]);
+			break;
+		}
+}
+
+/*
+ * Print an in-text reference, "[key]" or "[key|text]", starting at the
+ * opening bracket.  Returns the position after the closing bracket.
+ */
+static size_t
+print_html_ref(struct buf *b, const struct defn *d, size_t i)
+{
+	const char		*txt;
+	size_t			 txtsz, end;
+	int			 fn;
+	const struct defn	*xd;
+
+	if ((end = xref_token(b, d, i, &txt, &txtsz, &fn, &xd)) == 0) {
+		buf_putc(b, '[');
+		return i + 1;
+	}
+
+	if (xd != NULL) {
+		buf_puts(b, "<a href=\"");
+		html_escape(b, xd->fname, strlen(xd->fname));
+		buf_puts(b, "\">");
+	}
+	if (fn)
+		buf_puts(b, "<code>");
+	html_escape(b, txt, txtsz);
+	if (fn)
+		buf_puts(b, "</code>");
+	if (xd != NULL)
+		buf_puts(b, "</a>");
+	return end;
+}
+
+/*
+ * The description is already mostly HTML, so pass through known tags,
+ * escape everything else, and turn references into links.
+ */
+static void
+print_html_description(struct buf *b, const struct defn *d)
+{
+	size_t		 i, j, outpos;
+	enum tag	 tag;
+	int		 close;
+	const char	*attrs[ATTR__MAX];
+	size_t		 attrsz[ATTR__MAX];
+
+	buf_puts(b, "<p>\n");
+
+	for (i = 0; i < d->descsz; ) {
+		switch (d->desc[i]) {
+		case '\0':
+			i++;
+			break;
+		case '\n':
+			while (isspace((unsigned char)d->desc[i]))
+				i++;
+			tag = parse_tags(&d->desc[i],
+				NULL, NULL, NULL, &close);
+			if (tag == TAG__MAX || inlines[tag])
+				buf_puts(b, "\n<p>\n");
+			else
+				buf_putc(b, '\n');
+			break;
+		case '<':
+			tag = parse_tags(&d->desc[i],
+				&outpos, attrs, attrsz, &close);
+			if (tag == TAG__MAX) {
+				buf_puts(b, "&lt;");
+				i++;
+				break;
+			}
+			buf_printf(b, "<%s%s", close ? "/" : "",
+				tagnames[tag]);
+			if (!close && attrs[ATTR_HREF] != NULL) {
+				buf_puts(b, " href=\"");
+				html_escape(b, attrs[ATTR_HREF],
+					attrsz[ATTR_HREF]);
+				buf_putc(b, '"');
+			}
+			buf_putc(b, '>');
+			i += outpos;
+			break;
+		case '[':
+			if (d->desc[i + 1] == ']') {
+				buf_putc(b, d->desc[i++]);
+				break;
+			}
+			i = print_html_ref(b, d, i);
+			break;
+		case '&':
+			/* Pass through entities, escape otherwise. */
+			for (j = i + 1; j < d->descsz; j++)
+				if (!isalnum((unsigned char)d->desc[j]) &&
+				    d->desc[j] != '#')
+					break;
+			if (j > i + 1 && d->desc[j] == ';') {
+				buf_write(b, &d->desc[i], j - i + 1);
+				i = j + 1;
+			} else {
+				buf_puts(b, "&amp;");
+				i++;
+			}
+			break;
+		default:
+			html_escape(b, &d->desc[i++], 1);
+			break;
+		}
+	}
+
+	buf_putc(b, '\n');
+}
+
+/*
+ * Emit a full HTML5 document for the definition.
+ * References are linked to the file names of the resolved pages, which
+ * are assumed to be in the same directory.
+ */
+void
+print_html(struct buf *b, const struct defn *d, int verbose)
+{
+	size_t			  i, xrsz;
+	const struct defn	**xrs;
+	const struct decl	 *first;
+	struct buf		 *tmp;
+
+	buf_puts(b, "<!DOCTYPE html>\n"
+		"<html>\n"
+		"<head>\n"
+		"<meta charset=\"utf-8\" />\n"
+		"<title>");
+	html_escape(b, d->nms[0], strlen(d->nms[0]));
+	buf_puts(b, "(3)</title>\n"
+		"</head>\n"
+		"<body>\n");
+
+	buf_puts(b, "<h1 id=\"NAME\">NAME</h1>\n<p>\n");
+	for (i = 0; i < d->nmsz; i++) {
+		buf_puts(b, "<b>");
+		html_escape(b, d->nms[i], strlen(d->nms[i]));
+		buf_puts(b, i < d->nmsz - 1 ? "</b>,\n" : "</b>\n");
+	}
+	buf_puts(b, "&#8212; ");
+	html_escape(b, d->name, strlen(d->name));
+	buf_puts(b, "\n</p>\n");
+
+	buf_puts(b, "<h1 id=\"SYNOPSIS\">SYNOPSIS</h1>\n"
+		"<pre>\n#include &lt;sqlite3.h&gt;\n\n");
+	for (first = d->decls; first < d->decls + d->declsz; first++) {
+		tmp = buf_scratch(b);
+		synopsis_text(tmp, first);
+		if (tmp->sz > 0)
+			html_escape(b, tmp->data, tmp->sz);
+	}
+	buf_puts(b, "</pre>\n");
+
+	buf_puts(b, "<h1 id=\"DESCRIPTION\">DESCRIPTION</h1>\n");
+	print_html_description(b, d);
+
+	buf_printf(b, "<h1 id=\"IMPLEMENTATION_NOTES\">"
+		"IMPLEMENTATION NOTES</h1>\n"
+		"<p>\nThese declarations were extracted from the\n"
+		"interface documentation at line %zu.\n</p>\n"
+		"<pre>\n", d->ln);
+	html_escape(b, d->fulldesc, strlen(d->fulldesc));
+	buf_puts(b, "</pre>\n");
+
+	xrsz = xref_resolve(b, d, verbose, &xrs);
+	for (i = 0; i < xrsz; i++) {
+		buf_puts(b, i > 0 ? ",\n" :
+			"<h1 id=\"SEE_ALSO\">SEE ALSO</h1>\n<p>\n");
+		buf_puts(b, "<a href=\"");
+		html_escape(b, xrs[i]->fname, strlen(xrs[i]->fname));
+		buf_puts(b, "\">");
+		html_escape(b, xrs[i]->nms[0], strlen(xrs[i]->nms[0]));
+		buf_puts(b, "</a>(3)");
+	}
+	if (xrsz > 0)
+		buf_puts(b, "\n</p>\n");
+
+	for (i = 0; i < d->rxsz; i++) {
+		buf_puts(b, i > 0 ? ",\n" :
+			"<h1 id=\"REFERENCED_BY\">REFERENCED BY</h1>\n<p>\n");
+		buf_puts(b, "<a href=\"");
+		html_escape(b, d->rxs[i]->fname, strlen(d->rxs[i]->fname));
+		buf_puts(b, "\">");
+		html_escape(b, d->rxs[i]->nms[0], strlen(d->rxs[i]->nms[0]));
+		buf_puts(b, "</a>(3)");
+	}
+	if (d->rxsz > 0)
+		buf_puts(b, "\n</p>\n");
+
+	buf_puts(b, "</body>\n</html>\n");
+}
@@ -18,116 +18,38 @@
 #if HAVE_SYS_QUEUE
 # include <sys/queue.h>
 #endif
-#include <assert.h>
-#include <ctype.h>
-#if HAVE_ERR
-# include <err.h>
-#endif
-#include <search.h>
-#include <stdint.h> /* uintptr_t */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "extern.h"
 
-/*
- * Convenience function to look up which manpage "hosts" a certain
- * keyword.  For example, SQLITE_OK(3) also handles SQLITE_TOOBIG and so
- * on, so a reference to SQLITE_TOOBIG should actually point to
- * SQLITE_OK.
- * Returns the keyword's file if found or NULL.
- */
-static const char *
-lookup(const char *key)
-{
-	ENTRY			 ent;
-	ENTRY			*res;
-	const struct defn	*d;
-
-	ent.key = (char *)(uintptr_t)key;
-	ent.data = NULL;
-
-	if ((res = hsearch(ent, FIND)) == NULL)
-		return NULL;
-
-	d = (const struct defn *)res->data;
-	if (d->nmsz == 0)
-		return NULL;
-
-	assert(d->nms[0] != NULL);
-	return d->nms[0];
-}
-
-static int
-xrcmp(const void *p1, const void *p2)
-{
-	const char	*s1 = lookup(*(const char **)(uintptr_t)p1),
-	      		*s2 = lookup(*(const char **)(uintptr_t)p2);
-
-	/* Silence bogus warnings about un-consting. */
-
-
-	if (s1 == NULL)
-		s1 = "";
-	if (s2 == NULL)
-		s2 = "";
-
-	return strcasecmp(s1, s2);
-}
-
 void
-print_implementation(FILE *f, const struct defn *d, int verbose)
+print_implementation(struct buf *b, const struct defn *d, int verbose)
 {
-	size_t		 i, last;
-	const char	*res, *lastres;
+	size_t			  i, xrsz;
+	const struct defn	**xrs;
 
-	fprintf(f, "These declarations were extracted from the\n"
+	buf_printf(b, "These declarations were extracted from the\n"
 	      "interface documentation at line %zu.\n", d->ln);
-	fputs(".Bd -literal\n", f);
-	fputs(d->fulldesc, f);
-	fputs(".Ed\n", f);
-
-	/*
-	 * Look up all of our keywords (which are in the xrs field) in
-	 * the table of all known keywords.
-	 * Don't print duplicates.
-	 */
-
-	if (d->xrsz == 0)
-		return;
-	qsort(d->xrs, d->xrsz, sizeof(char *), xrcmp);
-	lastres = NULL;
-	for (last = 0, i = 0; i < d->xrsz; i++) {
-		res = lookup(d->xrs[i]);
-
-		/* Ignore self-reference. */
-
-		if (res == d->nms[0] && verbose)
-			warnx("%s:%zu: self-reference: %s",
-				d->fn, d->ln, d->xrs[i]);
-		if (res == d->nms[0])
-			continue;
-		if (res == NULL && verbose)
-			warnx("%s:%zu: ref not found: %s",
-				d->fn, d->ln, d->xrs[i]);
-		if (res == NULL)
-			continue;
-
-		/* Ignore duplicates. */
-
-		if (lastres == res)
-			continue;
-
-		if (last)
-			fputs(" ,\n", f);
-		else
-			fputs(".Sh SEE ALSO\n", f);
-
-		fprintf(f, ".Xr %s 3", res);
-		last = 1;
-		lastres = res;
-	}
-	if (last)
-		fputs("\n", f);
+	buf_puts(b, ".Bd -literal\n");
+	buf_puts(b, d->fulldesc);
+	buf_puts(b, ".Ed\n");
+
+	/* Print all resolved references. */
+
+	xrsz = xref_resolve(b, d, verbose, &xrs);
+	for (i = 0; i < xrsz; i++)
+		buf_printf(b, "%s.Xr %s 3", i > 0 ?
+			" ,\n" : ".Sh SEE ALSO\n", xrs[i]->nms[0]);
+	if (xrsz > 0)
+		buf_puts(b, "\n");
+
+	/* Print all pages referring to us, if computed. */
+
+	for (i = 0; i < d->rxsz; i++)
+		buf_printf(b, "%s.Xr %s 3", i > 0 ?
+			" ,\n" : ".Sh REFERENCED BY\n", d->rxs[i]->nms[0]);
+	if (d->rxsz > 0)
+		buf_puts(b, "\n");
 }
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extern.h"
+
+/*
+ * Write "sz" bytes of "cp" as a quoted JSON string.
+ * Input is assumed to be UTF-8 (or ASCII), so only the quote, the
+ * backslash, and control characters need escaping.
+ */
+void
+json_string(struct buf *b, const char *cp, size_t sz)
+{
+	size_t	 i;
+
+	buf_putc(b, '"');
+	for (i = 0; i < sz; i++)
+		switch (cp[i]) {
+		case '"':
+			buf_puts(b, "\\\"");
+			break;
+		case '\\':
+			buf_puts(b, "\\\\");
+			break;
+		case '\n':
+			buf_puts(b, "\\n");
+			break;
+		case '\t':
+			buf_puts(b, "\\t");
+			break;
+		default:
+			if ((unsigned char)cp[i] < 0x20)
+				buf_printf(b, "\\u%.4x",
+					(unsigned char)cp[i]);
+			else
+				buf_putc(b, cp[i]);
+			break;
+		}
+	buf_putc(b, '"');
+}
+
+/*
+ * Write an array of strings.
+ */
+static void
+json_strings(struct buf *b, const char *const *strs, size_t sz)
+{
+	size_t	 i;
+
+	buf_putc(b, '[');
+	for (i = 0; i < sz; i++) {
+		if (i > 0)
+			buf_putc(b, ',');
+		json_string(b, strs[i], strlen(strs[i]));
+	}
+	buf_putc(b, ']');
+}
+
+/*
+ * Write a single JSON object (without trailing newline) describing the
+ * definition: its names, brief description, keywords, declarations,
+ * the raw HTML description, and the resolved cross-references.
+ */
+void
+print_json(struct buf *b, const struct defn *d, int verbose)
+{
+	size_t			  i, xrsz;
+	const struct defn	**xrs;
+	const struct decl	 *first;
+	struct buf		 *tmp;
+
+	buf_puts(b, "{\"dt\":");
+	json_string(b, d->dt, strlen(d->dt));
+	buf_puts(b, ",\"names\":");
+	json_strings(b, d->nms, d->nmsz);
+	buf_puts(b, ",\"nd\":");
+	json_string(b, d->name, strlen(d->name));
+	buf_puts(b, ",\"keywords\":");
+	json_strings(b, d->keys, d->keysz);
+	buf_puts(b, ",\"page\":");
+	json_string(b, d->fname, strlen(d->fname));
+	buf_puts(b, ",\"file\":");
+	json_string(b, d->fn, strlen(d->fn));
+	buf_printf(b, ",\"line\":%zu", d->ln);
+
+	buf_puts(b, ",\"declarations\":[");
+	i = 0;
+	for (first = d->decls; first < d->decls + d->declsz; first++) {
+		if (first->type != DECLTYPE_CPP &&
+		    first->type != DECLTYPE_C)
+			continue;
+		tmp = buf_scratch(b);
+		synopsis_text(tmp, first);
+		if (tmp->sz > 0 && tmp->data[tmp->sz - 1] == '\n')
+			tmp->sz--;
+		buf_printf(b, "%s{\"type\":\"%s\",\"text\":",
+			i++ > 0 ? "," : "",
+			first->type == DECLTYPE_CPP ? "cpp" : "c");
+		json_string(b, first->text, first->textsz);
+		buf_puts(b, ",\"synopsis\":");
+		json_string(b, tmp->data, tmp->sz);
+		buf_putc(b, '}');
+	}
+	buf_putc(b, ']');
+
+	buf_puts(b, ",\"description\":");
+	json_string(b, d->desc == NULL ? "" : d->desc, d->descsz);
+	buf_puts(b, ",\"implementation\":");
+	json_string(b, d->fulldesc, strlen(d->fulldesc));
+
+	buf_puts(b, ",\"seealso\":[");
+	xrsz = xref_resolve(b, d, verbose, &xrs);
+	for (i = 0; i < xrsz; i++) {
+		if (i > 0)
+			buf_putc(b, ',');
+		json_string(b, xrs[i]->nms[0], strlen(xrs[i]->nms[0]));
+	}
+	buf_puts(b, "]}");
+}
@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#include <ctype.h>
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extern.h"
+
+/*
+ * Maximum depth of nested lists.
+ * Anything deeper is rendered at this depth.
+ */
+#define	MD_LISTMAX	8
+
+/*
+ * State of the description conversion.
+ */
+struct	mdstate {
+	enum tag	 lists[MD_LISTMAX]; /* open lists */
+	size_t		 listsz; /* number of open lists */
+	int		 intable; /* within <table> */
+	size_t		 rows; /* rows seen in table */
+	size_t		 cells; /* cells seen in row */
+	size_t		 cols; /* cells in first row */
+	int		 inpre; /* within <pre> */
+};
+
+/*
+ * Write "sz" bytes of "cp" with Markdown special characters escaped.
+ * Within tables, vertical bars must also be escaped.
+ */
+static void
+md_escape(struct buf *b, const char *cp, size_t sz, int intable)
+{
+	size_t	 i;
+
+	for (i = 0; i < sz; i++)
+		switch (cp[i]) {
+		case '|':
+			if (intable)
+				buf_putc(b, '\\');
+			buf_putc(b, '|');
+			break;
+		case '\\':
+		case '*':
+		case '_':
+		case '`':
+		case '[':
+		case ']':
+		case '#':
+			buf_putc(b, '\\');
+			buf_putc(b, cp[i]);
+			break;
+		case '<':
+			buf_puts(b, "&lt;");
+			break;
+		default:
+			buf_putc(b, cp[i]);
+			break;
+		}
+}
+
+/*
+ * Make sure that the output ends with "nl" newlines, so that "nl" of 1
+ * starts a new line and 2 starts a new paragraph.
+ * Does nothing at the start of the description (offset "start").
+ */
+static void
+md_break(struct buf *b, size_t start, size_t nl)
+{
+	size_t	 have;
+
+	if (b->sz <= start)
+		return;
+	while (b->sz > start && b->data[b->sz - 1] == ' ')
+		b->data[--b->sz] = '\0';
+	for (have = 0; have < nl && have < b->sz - start; have++)
+		if (b->data[b->sz - have - 1] != '\n')
+			break;
+	for ( ; have < nl; have++)
+		buf_putc(b, '\n');
+}
+
+/*
+ * Whether we're at the start of an output line.
+ */
+static int
+md_bol(const struct buf *b, size_t start)
+{
+
+	return b->sz <= start || b->data[b->sz - 1] == '\n';
+}
+
+/*
+ * Finish off the current table row, emitting the header delimiter row
+ * if this was the first one.
+ */
+static void
+md_endrow(struct buf *b, struct mdstate *st)
+{
+	size_t	 i;
+
+	if (st->cells == 0)
+		return;
+	buf_puts(b, " |\n");
+	if (st->rows++ == 0) {
+		st->cols = st->cells;
+		buf_putc(b, '|');
+		for (i = 0; i < st->cols; i++)
+			buf_puts(b, " --- |");
+		buf_putc(b, '\n');
+	}
+	st->cells = 0;
+}
+
+/*
+ * Convert one recognised HTML tag into Markdown.
+ */
+static void
+md_tag(struct buf *b, size_t start, struct mdstate *st,
+	enum tag tag, int close, const char *href, size_t hrefsz)
+{
+	size_t	 i;
+
+	switch (tag) {
+	case TAG_A:
+		/* Anchors without a target are only their text. */
+		if (href == NULL)
+			break;
+		if (close) {
+			buf_puts(b, "](");
+			buf_write(b, href, hrefsz);
+			buf_putc(b, ')');
+		} else
+			buf_putc(b, '[');
+		break;
+	case TAG_B:
+	case TAG_EM:
+		buf_puts(b, "**");
+		break;
+	case TAG_I:
+	case TAG_U:
+		buf_putc(b, '*');
+		break;
+	case TAG_BR:
+		if (st->intable)
+			buf_putc(b, ' ');
+		else
+			buf_puts(b, "  \n");
+		break;
+	case TAG_BLOCK:
+		md_break(b, start, 2);
+		if (!close)
+			buf_puts(b, "> ");
+		break;
+	case TAG_H3:
+		md_break(b, start, 2);
+		if (!close)
+			buf_puts(b, "### ");
+		break;
+	case TAG_P:
+		if (!st->intable)
+			md_break(b, start, 2);
+		break;
+	case TAG_PRE:
+		md_break(b, start, close ? 1 : 2);
+		buf_puts(b, "```\n");
+		if (close)
+			buf_putc(b, '\n');
+		st->inpre = !close;
+		break;
+	case TAG_DL:
+	case TAG_OL:
+	case TAG_UL:
+		if (close) {
+			if (st->listsz > 0)
+				st->listsz--;
+			md_break(b, start, 2);
+			break;
+		}
+		md_break(b, start, st->listsz > 0 ? 1 : 2);
+		if (st->listsz < MD_LISTMAX)
+			st->lists[st->listsz] = tag;
+		st->listsz++;
+		break;
+	case TAG_DT:
+	case TAG_LI:
+		if (close) {
+			if (tag == TAG_DT)
+				buf_puts(b, "**:");
+			break;
+		}
+		md_break(b, start, 1);
+		for (i = 1; i < st->listsz && i < MD_LISTMAX; i++)
+			buf_puts(b, "    ");
+		if (st->listsz > 0 && st->listsz <= MD_LISTMAX &&
+		    st->lists[st->listsz - 1] == TAG_OL)
+			buf_puts(b, "1. ");
+		else
+			buf_puts(b, "- ");
+		if (tag == TAG_DT)
+			buf_puts(b, "**");
+		break;
+	case TAG_TABLE:
+		if (close)
+			md_endrow(b, st);
+		md_break(b, start, 2);
+		st->intable = !close;
+		st->rows = st->cells = st->cols = 0;
+		break;
+	case TAG_TR:
+		if (!close && st->intable)
+			md_endrow(b, st);
+		break;
+	case TAG_TD:
+	case TAG_TH:
+		if (close || !st->intable)
+			break;
+		buf_puts(b, st->cells++ == 0 ? "| " : " | ");
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Print an in-text reference, "[key]" or "[key|text]", starting at the
+ * opening bracket.  Returns the position after the closing bracket.
+ */
+static size_t
+md_ref(struct buf *b, const struct defn *d,
+	const struct mdstate *st, size_t i)
+{
+	const char		*txt;
+	size_t			 txtsz, end;
+	int			 fn;
+	const struct defn	*xd;
+
+	if ((end = xref_token(b, d, i, &txt, &txtsz, &fn, &xd)) == 0) {
+		md_escape(b, "[", 1, st->intable);
+		return i + 1;
+	}
+
+	if (xd != NULL)
+		buf_putc(b, '[');
+	if (fn) {
+		buf_putc(b, '`');
+		buf_write(b, txt, txtsz);
+		buf_putc(b, '`');
+	} else
+		md_escape(b, txt, txtsz, st->intable);
+	if (xd != NULL)
+		buf_printf(b, "](%s)", xd->fname);
+	return end;
+}
+
+/*
+ * Convert the HTML description into Markdown.
+ * Sentences are broken onto their own lines as in the mdoc(7) output,
+ * except in tables where each row must be on one line.
+ */
+static void
+md_description(struct buf *b, const struct defn *d)
+{
+	size_t		 i, j, outpos, start = b->sz;
+	enum tag	 tag;
+	int		 close;
+	const char	*attrs[ATTR__MAX];
+	size_t		 attrsz[ATTR__MAX];
+	struct mdstate	 st;
+	const char	*href = NULL;
+	size_t		 hrefsz = 0;
+
+	memset(&st, 0, sizeof(struct mdstate));
+
+	for (i = 0; i < d->descsz; ) {
+		switch (d->desc[i]) {
+		case '\0':
+			i++;
+			break;
+		case '\n':
+			while (isspace((unsigned char)d->desc[i]))
+				i++;
+			if (st.intable)
+				buf_putc(b, ' ');
+			else if (st.inpre)
+				buf_putc(b, '\n');
+			else
+				md_break(b, start, 2);
+			break;
+		case ' ':
+			if (!st.inpre && (md_bol(b, start) ||
+			    b->data[b->sz - 1] == ' ')) {
+				i++;
+				break;
+			}
+			if (i > 0 && d->desc[i - 1] == '.' &&
+			    !st.intable && !st.inpre &&
+			    !(i >= 4 &&
+			      (strncasecmp(&d->desc[i - 4], "i.e.", 4) == 0 ||
+			       strncasecmp(&d->desc[i - 4], "e.g.", 4) == 0))) {
+				md_break(b, start, 1);
+				i++;
+				break;
+			}
+			buf_putc(b, d->desc[i++]);
+			break;
+		case '<':
+			tag = parse_tags(&d->desc[i],
+				&outpos, attrs, attrsz, &close);
+			if (tag == TAG__MAX) {
+				buf_puts(b, "&lt;");
+				i++;
+				break;
+			}
+			if (tag == TAG_A && !close) {
+				href = attrs[ATTR_HREF];
+				hrefsz = attrsz[ATTR_HREF];
+			}
+			md_tag(b, start, &st, tag, close, href, hrefsz);
+			if (tag == TAG_A && close)
+				href = NULL;
+			i += outpos;
+			break;
+		case '[':
+			if (d->desc[i + 1] == ']' || st.inpre) {
+				buf_putc(b, d->desc[i++]);
+				break;
+			}
+			i = md_ref(b, d, &st, i);
+			break;
+		case '&':
+			/* Pass through entities. */
+			for (j = i + 1; j < d->descsz; j++)
+				if (!isalnum((unsigned char)d->desc[j]) &&
+				    d->desc[j] != '#')
+					break;
+			if (j > i + 1 && d->desc[j] == ';') {
+				buf_write(b, &d->desc[i], j - i + 1);
+				i = j + 1;
+			} else
+				buf_putc(b, d->desc[i++]);
+			break;
+		default:
+			if (st.inpre)
+				buf_putc(b, d->desc[i]);
+			else
+				md_escape(b, &d->desc[i], 1, st.intable);
+			i++;
+			break;
+		}
+	}
+
+	if (st.intable)
+		md_endrow(b, &st);
+	md_break(b, start, 2);
+}
+
+/*
+ * Emit a Markdown document for the definition, loosely following the
+ * Markdown produced by mandoc(1) from the mdoc(7) output.
+ * References are linked relative to the current directory.
+ */
+void
+print_markdown(struct buf *b, const struct defn *d, int verbose)
+{
+	size_t			  i, xrsz;
+	const struct defn	**xrs;
+	const struct decl	 *first;
+
+	md_escape(b, d->dt, strlen(d->dt), 0);
+	buf_puts(b, "(3) - Library Functions Manual\n\n");
+
+	buf_puts(b, "# NAME\n\n");
+	for (i = 0; i < d->nmsz; i++) {
+		buf_puts(b, "**");
+		md_escape(b, d->nms[i], strlen(d->nms[i]), 0);
+		buf_puts(b, i < d->nmsz - 1 ? "**,\n" : "** - ");
+	}
+	md_escape(b, d->name, strlen(d->name), 0);
+	buf_puts(b, "\n\n");
+
+	buf_puts(b, "# SYNOPSIS\n\n"
+		"```c\n#include <sqlite3.h>\n\n");
+	for (first = d->decls; first < d->decls + d->declsz; first++)
+		synopsis_text(b, first);
+	buf_puts(b, "```\n\n");
+
+	buf_puts(b, "# DESCRIPTION\n\n");
+	md_description(b, d);
+
+	buf_printf(b, "# IMPLEMENTATION NOTES\n\n"
+		"These declarations were extracted from the\n"
+		"interface documentation at line %zu.\n\n"
+		"```c\n%s```\n", d->ln, d->fulldesc);
+
+	xrsz = xref_resolve(b, d, verbose, &xrs);
+	for (i = 0; i < xrsz; i++) {
+		buf_puts(b, i > 0 ? ",\n[" : "\n# SEE ALSO\n\n[");
+		md_escape(b, xrs[i]->nms[0], strlen(xrs[i]->nms[0]), 0);
+		buf_printf(b, "](%s)(3)", xrs[i]->fname);
+	}
+	if (xrsz > 0)
+		buf_putc(b, '\n');
+
+	for (i = 0; i < d->rxsz; i++) {
+		buf_puts(b, i > 0 ? ",\n[" : "\n# REFERENCED BY\n\n[");
+		md_escape(b, d->rxs[i]->nms[0],
+			strlen(d->rxs[i]->nms[0]), 0);
+		buf_printf(b, "](%s)(3)", d->rxs[i]->fname);
+	}
+	if (d->rxsz > 0)
+		buf_putc(b, '\n');
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#include <stdio.h>
+
+#include "extern.h"
+
+/*
+ * Render a valid mdoc(7) document into "b".
+ */
+void
+print_mdoc(struct buf *b, const struct defn *d, int verbose)
+{
+	const struct decl	*first;
+	size_t			 i;
+
+	/* Begin by outputting the mdoc(7) header. */
+
+	buf_puts(b, ".Dd $" "Mdocdate$\n");
+	buf_printf(b, ".Dt %s 3\n", d->dt);
+	buf_puts(b, ".Os\n");
+	buf_puts(b, ".Sh NAME\n");
+
+	/* Now print the name bits of each declaration. */
+
+	for (i = 0; i < d->nmsz; i++)
+		buf_printf(b, ".Nm %s%s\n", d->nms[i],
+			i < d->nmsz - 1 ? " ," : "");
+
+	buf_printf(b, ".Nd %s\n", d->name);
+
+	buf_puts(b, ".Sh SYNOPSIS\n");
+	buf_puts(b, ".In sqlite3.h\n");
+
+	for (first = d->decls; first < d->decls + d->declsz; first++)
+		print_synopsis(b, first, d);
+
+	buf_puts(b, ".Sh DESCRIPTION\n");
+	print_description(b, d);
+
+	buf_puts(b, ".Sh IMPLEMENTATION NOTES\n");
+	print_implementation(b, d, verbose);
+}
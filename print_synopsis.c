@@ -43,10 +43,106 @@ static const char *const preprocs[] = {
 	NULL,
 };
 
+/*
+ * Return the offset into a C declaration past any of the leading sqlite
+ * CPP decorations (SQLITE_API and so on).
+ */
+size_t
+synopsis_offs(const struct decl *first)
+{
+	size_t	 i, j, sz;
+
+	for (i = 0; i < first->textsz; ) {
+		for (j = 0; preprocs[j] != NULL; j++) {
+			sz = strlen(preprocs[j]);
+			if (strncmp(preprocs[j], &first->text[i], sz))
+				continue;
+			i += sz;
+			while (isspace((unsigned char)first->text[i]))
+				i++;
+			break;
+		}
+		if (preprocs[j] == NULL)
+			break;
+	}
+
+	return i;
+}
+
+/*
+ * Write a C declaration with comments stripped and white-space
+ * compressed, not leaving any space inside of parentheses or before
+ * commas and semicolons.
+ */
+static void
+synopsis_clean(struct buf *b, const char *cp, size_t sz)
+{
+	size_t	 i;
+	int	 sp = 0;
+
+	for (i = 0; i < sz; ) {
+		if (cp[i] == '/' && i + 1 < sz && cp[i + 1] == '*') {
+			for (i += 2; i + 1 < sz; i++)
+				if (cp[i] == '*' && cp[i + 1] == '/')
+					break;
+			i += 2;
+			sp = 1;
+			continue;
+		} else if (isspace((unsigned char)cp[i])) {
+			i++;
+			sp = 1;
+			continue;
+		}
+		if (sp && b->sz > 0 && b->data[b->sz - 1] != '(' &&
+		    b->data[b->sz - 1] != '\n' &&
+		    cp[i] != ')' && cp[i] != ',' && cp[i] != ';')
+			buf_putc(b, ' ');
+		sp = 0;
+		buf_putc(b, cp[i++]);
+	}
+}
+
+/*
+ * Write a declaration as it would appear in C source, less the sqlite
+ * CPP decorations, comments, and structure bodies, followed by a
+ * newline.
+ * This is for output types that show the synopsis as plain code.
+ * Writes nothing if the declaration is of an unknown type.
+ */
+void
+synopsis_text(struct buf *b, const struct decl *first)
+{
+	size_t		 i;
+	const char	*cp;
+
+	if (first->type == DECLTYPE_CPP) {
+		buf_printf(b, "#define %s\n", first->text);
+		return;
+	} else if (first->type != DECLTYPE_C)
+		return;
+
+	i = synopsis_offs(first);
+
+	if (first->textsz > 2 &&
+	    first->text[first->textsz - 2] == '}' &&
+	    strncmp(&first->text[i], "typedef", 7) &&
+	    (cp = strchr(&first->text[i], '{')) != NULL) {
+		while (cp > &first->text[i] &&
+		       isspace((unsigned char)cp[-1]))
+			cp--;
+		synopsis_clean(b, &first->text[i], cp - &first->text[i]);
+		buf_puts(b, ";\n");
+		return;
+	}
+
+	synopsis_clean(b, &first->text[i], first->textsz - i);
+	buf_putc(b, '\n');
+}
+
 void
-print_synopsis(FILE *f, const struct decl *first, const struct defn *d)
+print_synopsis(struct buf *b, const struct decl *first, const struct defn *d)
 {
-	size_t		 sz, i, j, ns, fnsz;
+	size_t		 i, ns, fnsz;
 	char		*cp;
 	const char	*args, *str, *end, *fn;
 
@@ -58,30 +154,18 @@ print_synopsis(FILE *f, const struct decl *first, const struct defn *d)
 	/* For C preprocessor defines: just print the CPP name. */
 
 	if (first->type == DECLTYPE_CPP) {
-		fprintf(f, ".Fd #define %s\n", first->text);
+		buf_printf(b, ".Fd #define %s\n", first->text);
 		return;
 	}
 
 	/* For C declarations, strip out the sqlite CPPs. */
 
-	for (i = 0; i < first->textsz; ) {
-		for (j = 0; preprocs[j] != NULL; j++) {
-			sz = strlen(preprocs[j]);
-			if (strncmp(preprocs[j], &first->text[i], sz))
-				continue;
-			i += sz;
-			while (isspace((unsigned char)first->text[i]))
-				i++;
-			break;
-		}
-		if (preprocs[j] == NULL)
-			break;
-	}
+	i = synopsis_offs(first);
 
 	/* If a typedef, immediately print Vt. */
 
 	if (strncmp(&first->text[i], "typedef", 7) == 0) {
-		fprintf(f, ".Vt %s\n", &first->text[i]);
+		buf_printf(b, ".Vt %s\n", &first->text[i]);
 		return;
 	}
 
@@ -91,7 +175,7 @@ print_synopsis(FILE *f, const struct decl *first, const struct defn *d)
 	    first->text[first->textsz - 2] == '}' &&
 	    (cp = strchr(&first->text[i], '{')) != NULL) {
 		*cp = '\0';
-		fprintf(f, ".Vt %s;\n", &first->text[i]);
+		buf_printf(b, ".Vt %s;\n", &first->text[i]);
 		/* Restore brace for later usage. */
 		*cp = '{';
 		return;
@@ -101,7 +185,7 @@ print_synopsis(FILE *f, const struct decl *first, const struct defn *d)
 
 	if (first->textsz > 2 &&
 	    first->text[first->textsz - 2] != ')') {
-		fprintf(f, ".Vt %s\n", &first->text[i]);
+		buf_printf(b, ".Vt %s\n", &first->text[i]);
 		return;
 	}
 
@@ -109,9 +193,9 @@ print_synopsis(FILE *f, const struct decl *first, const struct defn *d)
 
 	str = &first->text[i];
 	if ((args = strchr(str, '(')) == NULL || args == str) {
-		fputs(".Bd -literal\n", f);
-		fputs(&first->text[i], f);
-		fputs("\n.Ed\n", f);
+		buf_puts(b, ".Bd -literal\n");
+		buf_puts(b, &first->text[i]);
+		buf_puts(b, "\n.Ed\n");
 		return;
 	}
 
@@ -166,11 +250,11 @@ print_synopsis(FILE *f, const struct decl *first, const struct defn *d)
 	 */
 
 	if (end > str) {
-		fprintf(f, ".Ft %.*s\n", (int)(end - str + 1), str);
-		fprintf(f, ".Fo %.*s\n", (int)fnsz, fn);
+		buf_printf(b, ".Ft %.*s\n", (int)(end - str + 1), str);
+		buf_printf(b, ".Fo %.*s\n", (int)fnsz, fn);
 	} else {
-		fputs(".Ft void\n", f);
-		fprintf(f, ".Fo %.*s\n", (int)fnsz, fn);
+		buf_puts(b, ".Ft void\n");
+		buf_printf(b, ".Fo %.*s\n", (int)fnsz, fn);
 	}
 
 	/*
@@ -183,7 +267,7 @@ print_synopsis(FILE *f, const struct decl *first, const struct defn *d)
 		str = ++args;
 		while (isspace((unsigned char)*str))
 			str++;
-		fputs(".Fa \"", f);
+		buf_puts(b, ".Fa \"");
 		ns = 0;
 		while (*str != '\0' &&
 		       (ns || *str != ',') &&
@@ -229,17 +313,17 @@ print_synopsis(FILE *f, const struct decl *first, const struct defn *d)
 				    (ns == 0 && *str == ',') ||
 				    (ns == 0 && *str == ')'))
 					break;
-				fputc(' ', f);
+				buf_putc(b, ' ');
 			} else {
-				fputc(*str, f);
+				buf_putc(b, *str);
 				str++;
 			}
 		}
-		fputs("\"\n", f);
+		buf_puts(b, "\"\n");
 		if (*str == '\0' || *str == ')')
 			break;
 		args = str;
 	}
 
-	fputs(".Fc\n", f);
+	buf_puts(b, ".Fc\n");
 }
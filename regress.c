@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <dirent.h>
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sqlite2mdoc.h"
+
+/*
+ * Regression driver: render each page of a header as mdoc(7) into
+ * memory and compare it, less the first (.Dd) line, with the expected
+ * file of the same name in a directory.
+ * Only mismatches are reported, as unified diffs.
+ * With -l, instead check that the server mode of the given program
+ * answers a client pipelining many requests.
+ */
+
+#define	CONTEXT	3 /* lines of context in diffs */
+#define	PIPELINED 8192 /* bytes of requests sent by check_server() */
+
+/*
+ * A file's contents split into lines.
+ * Line "i" is the "lsz[i]" bytes at "ls[i]" (without the newline).
+ */
+struct	lines {
+	const char	**ls;
+	size_t		 *lsz;
+	size_t		  sz;
+	size_t		  maxsz; /* lines allocated */
+};
+
+/*
+ * A single line of a diff: kept, removed from the expected file, or
+ * added by the rendered one.
+ */
+struct	edit {
+	char		 op; /* ' ', '-', or '+' */
+	size_t		 a; /* line in expected */
+	size_t		 b; /* line in rendered */
+};
+
+/*
+ * Memory (growing) that the writer renders into.
+ */
+struct	out {
+	char		*data;
+	size_t		 sz;
+	size_t		 maxsz;
+};
+
+static int
+writer(void *arg, const char *buf, size_t sz)
+{
+	struct out	*o = arg;
+	void		*pp;
+
+	if (o->sz + sz > o->maxsz) {
+		o->maxsz = (o->sz + sz) * 2;
+		if ((pp = realloc(o->data, o->maxsz)) == NULL)
+			err(1, NULL);
+		o->data = pp;
+	}
+	memcpy(o->data + o->sz, buf, sz);
+	o->sz += sz;
+	return 1;
+}
+
+/*
+ * Read the whole of "fn", relative to "dfd", into "o".
+ * Returns zero if it can't be opened, with errno set.
+ */
+static int
+readat(int dfd, const char *fn, struct out *o)
+{
+	struct stat	 st;
+	int		 fd;
+	ssize_t		 ssz;
+
+	o->sz = 0;
+	if ((fd = openat(dfd, fn, O_RDONLY)) == -1)
+		return 0;
+	if (fstat(fd, &st) == -1)
+		err(1, "%s", fn);
+	if ((size_t)st.st_size > o->maxsz) {
+		o->maxsz = st.st_size;
+		if ((o->data = realloc(o->data, o->maxsz)) == NULL)
+			err(1, NULL);
+	}
+	while (o->sz < (size_t)st.st_size) {
+		ssz = read(fd, o->data + o->sz, st.st_size - o->sz);
+		if (ssz == -1)
+			err(1, "%s", fn);
+		if (ssz == 0)
+			break;
+		o->sz += ssz;
+	}
+	close(fd);
+	return 1;
+}
+
+static void
+lines_split(struct lines *l, const char *cp, size_t sz)
+{
+	const char	*end;
+
+	l->sz = 0;
+	while (sz > 0) {
+		if (l->sz == l->maxsz) {
+			l->maxsz = l->maxsz == 0 ? 64 : l->maxsz * 2;
+			l->ls = reallocarray(l->ls,
+				l->maxsz, sizeof(char *));
+			l->lsz = reallocarray(l->lsz,
+				l->maxsz, sizeof(size_t));
+			if (l->ls == NULL || l->lsz == NULL)
+				err(1, NULL);
+		}
+		l->ls[l->sz] = cp;
+		if ((end = memchr(cp, '\n', sz)) == NULL)
+			end = cp + sz - 1;
+		l->lsz[l->sz] = end - cp + (*end != '\n');
+		l->sz++;
+		sz -= end - cp + 1;
+		cp = end + 1;
+	}
+}
+
+static int
+lines_eq(const struct lines *a, size_t i, const struct lines *b, size_t j)
+{
+
+	return a->lsz[i] == b->lsz[j] &&
+		memcmp(a->ls[i], b->ls[j], a->lsz[i]) == 0;
+}
+
+static void
+print_line(char op, const struct lines *l, size_t i)
+{
+
+	putchar(op);
+	fwrite(l->ls[i], l->lsz[i], 1, stdout);
+	putchar('\n');
+}
+
+/*
+ * Print a unified diff between "a" (expected) and "b" (rendered).
+ * Pages are small, so this uses the simple quadratic longest common
+ * subsequence.
+ */
+static void
+diff(const char *an, const struct lines *a, const char *bn,
+	const struct lines *b)
+{
+	size_t		*lcs, i, j, n, sz = 0, start, end, k;
+	size_t		 as, bs, ac, bc;
+	struct edit	*ed;
+	size_t		 w = b->sz + 1;
+
+	if ((lcs = calloc((a->sz + 1) * w, sizeof(size_t))) == NULL)
+		err(1, NULL);
+	for (i = a->sz; i-- > 0; )
+		for (j = b->sz; j-- > 0; )
+			lcs[i * w + j] = lines_eq(a, i, b, j) ?
+				lcs[(i + 1) * w + j + 1] + 1 :
+				lcs[(i + 1) * w + j] > lcs[i * w + j + 1] ?
+				lcs[(i + 1) * w + j] : lcs[i * w + j + 1];
+
+	if ((ed = calloc(a->sz + b->sz, sizeof(struct edit))) == NULL)
+		err(1, NULL);
+	for (i = j = 0; i < a->sz || j < b->sz; sz++)
+		if (i < a->sz && j < b->sz && lines_eq(a, i, b, j)) {
+			ed[sz].op = ' ';
+			ed[sz].a = i++;
+			ed[sz].b = j++;
+		} else if (i < a->sz && (j == b->sz ||
+		    lcs[(i + 1) * w + j] >= lcs[i * w + j + 1])) {
+			ed[sz].op = '-';
+			ed[sz].a = i++;
+			ed[sz].b = j;
+		} else {
+			ed[sz].op = '+';
+			ed[sz].a = i;
+			ed[sz].b = j++;
+		}
+	free(lcs);
+
+	printf("--- %s\n+++ %s\n", an, bn);
+
+	for (n = 0; n < sz; n = end) {
+		while (n < sz && ed[n].op == ' ')
+			n++;
+		if (n == sz)
+			break;
+
+		/* Extend the hunk while changes are close together. */
+
+		start = n > CONTEXT ? n - CONTEXT : 0;
+		for (end = n; end < sz; end++) {
+			if (ed[end].op != ' ')
+				continue;
+			for (k = end; k < sz && ed[k].op == ' '; k++)
+				continue;
+			if (k == sz || k - end > 2 * CONTEXT)
+				break;
+			end = k;
+		}
+		end = end + CONTEXT < sz ? end + CONTEXT : sz;
+
+		as = ed[start].a;
+		bs = ed[start].b;
+		for (ac = bc = 0, k = start; k < end; k++) {
+			ac += ed[k].op != '+';
+			bc += ed[k].op != '-';
+		}
+		printf("@@ -%zu,%zu +%zu,%zu @@\n",
+			ac ? as + 1 : as, ac, bc ? bs + 1 : bs, bc);
+		for (k = start; k < end; k++)
+			if (ed[k].op == '+')
+				print_line('+', b, ed[k].b);
+			else
+				print_line(ed[k].op, a, ed[k].a);
+	}
+
+	free(ed);
+}
+
+/*
+ * Check all pages of "hdr" against the expected files in "dir".
+ * Returns the number of mismatches.
+ */
+static size_t
+check(const char *hdr, const char *dir)
+{
+	struct sqlite2mdoc		*s;
+	const struct sqlite2mdoc_page	*pg;
+	struct out			 in, got, want;
+	struct lines			 lgot, lwant;
+	DIR				*dp;
+	struct dirent			*de;
+	const char			*fn, *cp;
+	char				 path[PATH_MAX];
+	size_t				 bad = 0, sz;
+	int				 dfd, found;
+
+	memset(&in, 0, sizeof(struct out));
+	memset(&got, 0, sizeof(struct out));
+	memset(&want, 0, sizeof(struct out));
+	memset(&lgot, 0, sizeof(struct lines));
+	memset(&lwant, 0, sizeof(struct lines));
+
+	if (!readat(AT_FDCWD, hdr, &in))
+		err(1, "%s", hdr);
+	if ((dfd = open(dir, O_RDONLY | O_DIRECTORY)) == -1)
+		err(1, "%s", dir);
+
+	if ((s = sqlite2mdoc_parse(hdr, in.data, in.sz, 0)) == NULL)
+		errx(1, "%s: parse failed", hdr);
+	sqlite2mdoc_postprocess(s, SQLITE2MDOC_MDOC);
+
+	for (pg = sqlite2mdoc_first(s); pg != NULL;
+	     pg = sqlite2mdoc_next(pg)) {
+		fn = sqlite2mdoc_page_file(pg);
+		snprintf(path, sizeof(path), "%s/%s", dir, fn);
+		got.sz = 0;
+		sqlite2mdoc_render(s, pg, SQLITE2MDOC_MDOC, writer, &got);
+
+		/* Skip the .Dd line. */
+
+		cp = memchr(got.data, '\n', got.sz);
+		cp = cp == NULL ? got.data + got.sz : cp + 1;
+		sz = got.data + got.sz - cp;
+
+		/* A page not expected is diffed against nothing. */
+
+		found = readat(dfd, fn, &want);
+		if (!found && errno != ENOENT)
+			err(1, "%s", path);
+		if (found && want.sz == sz && memcmp(want.data, cp, sz) == 0)
+			continue;
+		lines_split(&lwant, want.data, want.sz);
+		lines_split(&lgot, cp, sz);
+		diff(found ? path : "/dev/null", &lwant, fn, &lgot);
+		bad++;
+	}
+
+	/* Expected files without a page. */
+
+	if ((dp = fdopendir(dup(dfd))) == NULL)
+		err(1, "%s", dir);
+	while ((de = readdir(dp)) != NULL) {
+		if ((cp = strrchr(de->d_name, '.')) == NULL ||
+		    strcmp(cp, ".3"))
+			continue;
+		for (pg = sqlite2mdoc_first(s); pg != NULL;
+		     pg = sqlite2mdoc_next(pg))
+			if (strcmp(sqlite2mdoc_page_file(pg),
+			    de->d_name) == 0)
+				break;
+		if (pg == NULL) {
+			printf("%s/%s: not produced\n", dir, de->d_name);
+			bad++;
+		}
+	}
+	closedir(dp);
+	close(dfd);
+
+	sqlite2mdoc_free(s);
+	free(in.data);
+	free(got.data);
+	free(want.data);
+	free(lgot.ls);
+	free(lgot.lsz);
+	free(lwant.ls);
+	free(lwant.lsz);
+	return bad;
+}
+
+/*
+ * Run "prog" as a server of "hdr" and send it, in one go, requests for
+ * the same page until they're well over the length of one request line
+ * or one read, then check that each is answered with the same page.
+ * Returns the number of mismatches.
+ */
+static size_t
+check_server(const char *prog, const char *hdr)
+{
+	struct sockaddr_un	 sun;
+	struct out		 req, resp;
+	char			 dir[] = "/tmp/sqlite2mdoc-regress.XXXXXXXXXX";
+	const char		*line = "render mdoc sqlite3_open\n", *cp;
+	char			*ep;
+	size_t			 i, n = 0, bad = 0, sz, first = 0;
+	ssize_t			 ssz;
+	pid_t			 pid;
+	int			 fd, st;
+
+	memset(&req, 0, sizeof(struct out));
+	memset(&resp, 0, sizeof(struct out));
+	memset(&sun, 0, sizeof(struct sockaddr_un));
+
+	if (mkdtemp(dir) == NULL)
+		err(1, "%s", dir);
+	sun.sun_family = AF_UNIX;
+	snprintf(sun.sun_path, sizeof(sun.sun_path), "%s/sock", dir);
+
+	if ((pid = fork()) == -1)
+		err(1, "fork");
+	if (pid == 0) {
+		execl(prog, prog, "-l", sun.sun_path, hdr, (char *)NULL);
+		err(1, "%s", prog);
+	}
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		err(1, "socket");
+	for (i = 0; connect(fd, (struct sockaddr *)&sun,
+	     sizeof(sun)) == -1; i++) {
+		if (i == 500)
+			err(1, "%s", sun.sun_path);
+		usleep(10000);
+	}
+
+	while (req.sz < PIPELINED) {
+		writer(&req, line, strlen(line));
+		n++;
+	}
+	for (i = 0; i < req.sz; i += ssz)
+		if ((ssz = write(fd, req.data + i, req.sz - i)) == -1)
+			err(1, "%s", sun.sun_path);
+	if (shutdown(fd, SHUT_WR) == -1)
+		err(1, "%s", sun.sun_path);
+	while ((ssz = read(fd, req.data, req.maxsz)) > 0)
+		writer(&resp, req.data, ssz);
+	if (ssz == -1)
+		warn("%s", sun.sun_path);
+	writer(&resp, "", 1);
+	resp.sz--;
+	close(fd);
+
+	kill(pid, SIGTERM);
+	if (waitpid(pid, &st, 0) == -1)
+		err(1, "waitpid");
+	rmdir(dir);
+
+	/* Each response is "ok <size>\n" followed by the page. */
+
+	for (cp = resp.data, i = 0; i < n; i++) {
+		if (strncmp(cp, "ok ", 3))
+			break;
+		sz = strtoul(cp + 3, &ep, 10);
+		if (*ep != '\n' ||
+		    sz > resp.sz - (ep + 1 - resp.data))
+			break;
+		if (i == 0)
+			first = sz;
+		else if (sz != first)
+			break;
+		cp = ep + 1 + sz;
+	}
+
+	if (i < n || cp != resp.data + resp.sz) {
+		printf("%s: server answered %zu of %zu requests\n",
+			hdr, i, n);
+		bad++;
+	}
+	free(req.data);
+	free(resp.data);
+	return bad;
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t	 bad = 0;
+
+	if (argc == 4 && strcmp(argv[1], "-l") == 0)
+		bad += check_server(argv[2], argv[3]);
+	else if (argc < 3 || (argc - 1) % 2)
+		goto usage;
+	else
+		for (argc--, argv++; argc > 0; argc -= 2, argv += 2)
+			bad += check(argv[0], argv[1]);
+
+	if (fflush(stdout) == EOF)
+		err(1, "<stdout>");
+	if (bad > 0)
+		fprintf(stderr, "%zu mismatches\n", bad);
+	return bad > 0;
+usage:
+	fprintf(stderr, "usage: %s header expectdir ...\n"
+		"       %s -l sqlite2mdoc header\n",
+		getprogname(), getprogname());
+	return 1;
+}
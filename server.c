@@ -0,0 +1,569 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <errno.h>
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "extern.h"
+
+/*
+ * Server mode: parse the headers once and answer requests for pages on
+ * a UNIX socket until interrupted.
+ * Each request is a single line and each response is either
+ *
+ *   ok <size>\n<size bytes>
+ *   error <message>\n
+ *
+ * Clients are multiplexed with poll(2) and may send any number of
+ * requests, which are answered in order.
+ * A client's input isn't read while a response to it is pending, and
+ * once it stops sending, its outstanding requests are still answered.
+ */
+
+#define	SERVER_MAXCLIENTS 64 /* concurrent connections */
+#define	SERVER_MAXLINE	 1024 /* longest request line */
+
+/*
+ * Filenames of pages depend on the output type, so each is separately
+ * post-processed (on first use) from its own parse.
+ */
+enum	sclass {
+	SCLASS_MDOC, /* mdoc, json, jsonl */
+	SCLASS_HTML,
+	SCLASS_MARKDOWN,
+	SCLASS__MAX
+};
+
+static	const char *const sclass_suffixes[SCLASS__MAX] = {
+	".3", /* SCLASS_MDOC */
+	".3.html", /* SCLASS_HTML */
+	".3.md", /* SCLASS_MARKDOWN */
+};
+
+/*
+ * A header kept in memory and its parses.
+ */
+struct	sfile {
+	const char	*fn; /* filename */
+	struct buf	 text; /* contents */
+	struct parse	 ps[SCLASS__MAX]; /* parses */
+	int		 parsed[SCLASS__MAX]; /* whether ps is valid */
+};
+
+/*
+ * A connected client.
+ */
+struct	sclient {
+	int		 fd; /* socket */
+	struct buf	 in; /* unprocessed input */
+	struct buf	 out; /* pending output */
+	size_t		 outoff; /* output already written */
+	int		 eof; /* no more input */
+};
+
+struct	server {
+	struct sfile	*fs; /* headers */
+	size_t		 fsz; /* number of headers */
+	struct buf	 ob; /* scratch for rendering */
+	int		 verbose; /* show parse warnings */
+};
+
+/* Argument to "render" for each output type. */
+static	const char *const server_types[OUTTYPE__MAX] = {
+	"mdoc", /* OUTTYPE_MDOC */
+	"html", /* OUTTYPE_HTML */
+	"markdown", /* OUTTYPE_MARKDOWN */
+	"json", /* OUTTYPE_JSON */
+	"jsonl", /* OUTTYPE_JSONL */
+};
+
+static	volatile sig_atomic_t server_stop;
+
+static void
+server_sig(int sig)
+{
+
+	server_stop = 1;
+}
+
+static enum sclass
+server_sclass(enum outtype type)
+{
+
+	switch (type) {
+	case OUTTYPE_HTML:
+		return SCLASS_HTML;
+	case OUTTYPE_MARKDOWN:
+		return SCLASS_MARKDOWN;
+	default:
+		return SCLASS_MDOC;
+	}
+}
+
+/*
+ * Get the parse of "f" for the class, parsing and post-processing it
+ * if not already done.
+ * Returns NULL if the header couldn't be parsed.
+ */
+static struct parse *
+server_parse(const struct server *srv, struct sfile *f, enum sclass c)
+{
+	struct defn	*d;
+
+	if (f->parsed[c])
+		return f->parsed[c] > 0 ? &f->ps[c] : NULL;
+
+	parse_init(&f->ps[c], f->fn);
+	f->ps[c].verbose = srv->verbose;
+	parse_buf(&f->ps[c], f->text.data, f->text.sz);
+	if (!parse_finish(&f->ps[c])) {
+		parse_free(&f->ps[c]);
+		f->parsed[c] = -1;
+		return NULL;
+	}
+	for (d = f->ps[c].defs; d < f->ps[c].defs + f->ps[c].defsz; d++)
+		parse_postprocess(d, sclass_suffixes[c]);
+	xref_order(f->ps[c].defs, f->ps[c].defsz);
+	f->parsed[c] = 1;
+	return &f->ps[c];
+}
+
+/*
+ * Look up the page documenting "key" in the first header that has one.
+ * Returns the page or NULL if not found.
+ */
+static const struct defn *
+server_find(struct server *srv, enum sclass c, const char *key)
+{
+	const struct parse	*p;
+	const struct defn	*d;
+	size_t			 i;
+
+	for (i = 0; i < srv->fsz; i++) {
+		if ((p = server_parse(srv, &srv->fs[i], c)) == NULL)
+			continue;
+		if ((d = xref_lookup(&p->keys, key)) != NULL &&
+		    d->postprocessed)
+			return d;
+	}
+	return NULL;
+}
+
+static void
+server_error(struct sclient *cl, const char *msg)
+{
+
+	buf_printf(&cl->out, "error %s\n", msg);
+}
+
+/*
+ * Respond with the contents of the server's scratch buffer.
+ */
+static void
+server_ok(struct server *srv, struct sclient *cl)
+{
+
+	buf_printf(&cl->out, "ok %zu\n", srv->ob.sz);
+	buf_write(&cl->out, srv->ob.data, srv->ob.sz);
+}
+
+/*
+ * "list": the name, filename, and source of every page, one per line
+ * and tab-separated.
+ */
+static void
+server_list(struct server *srv, struct sclient *cl)
+{
+	const struct parse	*p;
+	const struct defn	*d;
+	size_t			 i;
+
+	buf_reset(&srv->ob);
+	for (i = 0; i < srv->fsz; i++) {
+		if ((p = server_parse(srv, &srv->fs[i], SCLASS_MDOC)) == NULL)
+			continue;
+		for (d = p->defs; d < p->defs + p->defsz; d++)
+			if (d->postprocessed)
+				buf_printf(&srv->ob, "%s\t%s\t%s:%zu\n",
+					d->nms[0], d->fname, d->fn, d->ln);
+	}
+	server_ok(srv, cl);
+}
+
+/*
+ * "lookup key": like a single line of "list" for the page documenting
+ * the keyword or name.
+ */
+static void
+server_lookup(struct server *srv, struct sclient *cl, const char *key)
+{
+	const struct defn	*d;
+
+	if ((d = server_find(srv, SCLASS_MDOC, key)) == NULL) {
+		server_error(cl, "not found");
+		return;
+	}
+	buf_reset(&srv->ob);
+	buf_printf(&srv->ob, "%s\t%s\t%s:%zu\n",
+		d->nms[0], d->fname, d->fn, d->ln);
+	server_ok(srv, cl);
+}
+
+/*
+ * "render type key": the page documenting the keyword or name, in the
+ * given output type.
+ */
+static void
+server_render(struct server *srv, struct sclient *cl, const char *args)
+{
+	const struct defn	*d;
+	const char		*key;
+	enum outtype		 type;
+	size_t			 sz;
+
+	if ((key = strchr(args, ' ')) == NULL) {
+		server_error(cl, "usage: render type key");
+		return;
+	}
+	sz = key++ - args;
+	for (type = 0; type < OUTTYPE__MAX; type++)
+		if (strlen(server_types[type]) == sz &&
+		    strncmp(args, server_types[type], sz) == 0)
+			break;
+	if (type == OUTTYPE__MAX) {
+		server_error(cl, "unknown type");
+		return;
+	}
+	if ((d = server_find(srv, server_sclass(type), key)) == NULL) {
+		server_error(cl, "not found");
+		return;
+	}
+
+	buf_reset(&srv->ob);
+	switch (type) {
+	case OUTTYPE_JSON:
+	case OUTTYPE_JSONL:
+		print_json(&srv->ob, d, srv->verbose);
+		buf_putc(&srv->ob, '\n');
+		break;
+	case OUTTYPE_HTML:
+		print_html(&srv->ob, d, srv->verbose);
+		break;
+	case OUTTYPE_MARKDOWN:
+		print_markdown(&srv->ob, d, srv->verbose);
+		break;
+	default:
+		print_mdoc(&srv->ob, d, srv->verbose);
+		break;
+	}
+	server_ok(srv, cl);
+}
+
+static void
+server_request(struct server *srv, struct sclient *cl, char *line)
+{
+
+	if (strcmp(line, "list") == 0)
+		server_list(srv, cl);
+	else if (strncmp(line, "lookup ", 7) == 0)
+		server_lookup(srv, cl, line + 7);
+	else if (strncmp(line, "render ", 7) == 0)
+		server_render(srv, cl, line + 7);
+	else
+		server_error(cl, "unknown request");
+}
+
+/*
+ * Answer all complete requests in the client's input, stopping if
+ * there's output pending so that a client can't make us buffer
+ * arbitrarily many responses.
+ * Returns zero if the client must be disconnected, which is if what's
+ * left is an unterminated line that's too long to be a request.
+ */
+static int
+server_process(struct server *srv, struct sclient *cl)
+{
+	char	*cp;
+	size_t	 len;
+
+	while (cl->out.sz == 0 && cl->in.sz > 0) {
+		if ((cp = memchr(cl->in.data, '\n', cl->in.sz)) == NULL)
+			return cl->in.sz <= SERVER_MAXLINE;
+		*cp = '\0';
+		len = cp - cl->in.data + 1;
+		if (cp > cl->in.data && cp[-1] == '\r')
+			cp[-1] = '\0';
+		server_request(srv, cl, cl->in.data);
+		memmove(cl->in.data, cl->in.data + len, cl->in.sz - len);
+		cl->in.sz -= len;
+	}
+	return 1;
+}
+
+/*
+ * Write as much of the pending output as possible.
+ * Returns zero if the client must be disconnected.
+ */
+static int
+server_flush(struct sclient *cl)
+{
+	ssize_t	 ssz;
+
+	while (cl->outoff < cl->out.sz) {
+		ssz = write(cl->fd, cl->out.data + cl->outoff,
+			cl->out.sz - cl->outoff);
+		if (ssz == -1 && errno == EINTR)
+			continue;
+		if (ssz == -1 && errno == EAGAIN)
+			return 1;
+		if (ssz == -1)
+			return 0;
+		cl->outoff += ssz;
+	}
+	buf_reset(&cl->out);
+	cl->outoff = 0;
+	return 1;
+}
+
+/*
+ * Read what's available from the client, noting the end of its input.
+ * Returns zero if the client must be disconnected.
+ */
+static int
+server_read(struct sclient *cl)
+{
+	char	 tmp[4096];
+	ssize_t	 ssz;
+
+	if ((ssz = read(cl->fd, tmp, sizeof(tmp))) == -1)
+		return errno == EINTR || errno == EAGAIN;
+	if (ssz == 0)
+		cl->eof = 1;
+	else
+		buf_write(&cl->in, tmp, ssz);
+	return 1;
+}
+
+/*
+ * Service a client given the events "revents" polled for it: read
+ * only if nothing is pending, then alternately answer requests and
+ * write responses until a write would block.
+ * Returns zero if the client must be disconnected, including when it
+ * has stopped sending and everything it asked for has been written.
+ */
+static int
+server_client(struct server *srv, struct sclient *cl, short revents)
+{
+
+	if (revents & (POLLERR|POLLNVAL))
+		return 0;
+	if ((revents & (POLLIN|POLLHUP)) &&
+	    cl->out.sz == 0 && !cl->eof && !server_read(cl))
+		return 0;
+	for (;;) {
+		if (!server_process(srv, cl))
+			return 0;
+		if (cl->out.sz == 0)
+			break;
+		if (!server_flush(cl))
+			return 0;
+		if (cl->out.sz > 0)
+			return 1;
+	}
+	return !cl->eof;
+}
+
+static void
+server_close(struct sclient *cl)
+{
+
+	close(cl->fd);
+	buf_free(&cl->in);
+	buf_free(&cl->out);
+}
+
+/*
+ * Read all headers into memory and listen on "sock".
+ * Returns zero on failure.
+ */
+static int
+server_open(struct server *srv, const char *sock, char *fns[],
+	size_t fnsz, int *fd)
+{
+	struct sockaddr_un	 sun;
+	char			 tmp[8192];
+	size_t			 i, sz;
+	FILE			*f;
+
+	if ((srv->fs = mem_calloc(MEM_PARSE,
+	    fnsz, sizeof(struct sfile))) == NULL)
+		err(1, NULL);
+	/* Count each header as it's set up so teardown frees it. */
+
+	for (i = 0; i < fnsz; i++) {
+		srv->fs[srv->fsz++].fn = fns[i];
+		if ((f = fopen(fns[i], "r")) == NULL) {
+			warn("%s", fns[i]);
+			return 0;
+		}
+		while ((sz = fread(tmp, 1, sizeof(tmp), f)) > 0)
+			buf_write(&srv->fs[i].text, tmp, sz);
+		if (ferror(f)) {
+			warn("%s", fns[i]);
+			fclose(f);
+			return 0;
+		}
+		fclose(f);
+	}
+
+	memset(&sun, 0, sizeof(struct sockaddr_un));
+	sun.sun_family = AF_UNIX;
+	if (strlcpy(sun.sun_path, sock,
+	    sizeof(sun.sun_path)) >= sizeof(sun.sun_path)) {
+		warnx("%s: socket name too long", sock);
+		return 0;
+	}
+	if ((*fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		warn("socket");
+		return 0;
+	}
+	if (bind(*fd, (struct sockaddr *)&sun, sizeof(sun)) == -1) {
+		warn("%s: bind", sock);
+		close(*fd);
+		return 0;
+	}
+	if (listen(*fd, SERVER_MAXCLIENTS) == -1 ||
+	    fcntl(*fd, F_SETFL, O_NONBLOCK) == -1) {
+		warn("%s: listen", sock);
+		close(*fd);
+		unlink(sock);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Serve the headers "fns" on the UNIX socket "sock" until interrupted,
+ * removing the socket on exit.
+ * Returns zero on failure, non-zero on (interrupted) success.
+ */
+int
+server_run(const char *sock, char *fns[], size_t fnsz, int verbose)
+{
+	struct server		 srv;
+	struct sclient		 cls[SERVER_MAXCLIENTS];
+	struct pollfd		 pfds[SERVER_MAXCLIENTS + 1];
+	struct sigaction	 sa;
+	size_t			 i, j, clsz = 0;
+	int			 fd, cfd, rc = 0;
+
+	memset(&srv, 0, sizeof(struct server));
+	srv.verbose = verbose;
+
+	memset(&sa, 0, sizeof(struct sigaction));
+	sa.sa_handler = server_sig;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (!server_open(&srv, sock, fns, fnsz, &fd))
+		goto out;
+
+	/* Parse and post-process up front for the common case. */
+
+	for (i = 0; i < srv.fsz; i++)
+		server_parse(&srv, &srv.fs[i], SCLASS_MDOC);
+
+	while (!server_stop) {
+		pfds[0].fd = clsz < SERVER_MAXCLIENTS ? fd : -1;
+		pfds[0].events = POLLIN;
+		for (i = 0; i < clsz; i++) {
+			pfds[i + 1].fd = cls[i].fd;
+			pfds[i + 1].events =
+				cls[i].out.sz > 0 ? POLLOUT : POLLIN;
+		}
+		if (poll(pfds, clsz + 1, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			warn("poll");
+			break;
+		}
+
+		/*
+		 * Service clients first, as accepting changes the
+		 * array, compacting it as clients are closed.
+		 */
+
+		for (i = j = 0; i < clsz; i++) {
+			if (!server_client(&srv,
+			    &cls[i], pfds[i + 1].revents)) {
+				server_close(&cls[i]);
+				continue;
+			}
+			cls[j++] = cls[i];
+		}
+		clsz = j;
+
+		if (!(pfds[0].revents & POLLIN))
+			continue;
+		if ((cfd = accept(fd, NULL, NULL)) == -1) {
+			if (errno != EINTR && errno != EAGAIN &&
+			    errno != ECONNABORTED)
+				warn("accept");
+			continue;
+		}
+		if (fcntl(cfd, F_SETFL, O_NONBLOCK) == -1) {
+			warn("fcntl");
+			close(cfd);
+			continue;
+		}
+		memset(&cls[clsz], 0, sizeof(struct sclient));
+		cls[clsz++].fd = cfd;
+	}
+
+	for (i = 0; i < clsz; i++)
+		server_close(&cls[i]);
+	close(fd);
+	unlink(sock);
+	rc = 1;
+out:
+	for (i = 0; i < srv.fsz; i++) {
+		for (j = 0; j < SCLASS__MAX; j++)
+			if (srv.fs[i].parsed[j] > 0)
+				parse_free(&srv.fs[i].ps[j]);
+		buf_free(&srv.fs[i].text);
+	}
+	mem_free(srv.fs);
+	buf_free(&srv.ob);
+	return rc;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef SQLITE2MDOC_H
+#define SQLITE2MDOC_H
+
+/*
+ * Library interface to sqlite2mdoc(1).
+ * Requires <stddef.h> (or any other header defining size_t).
+ *
+ * A header is parsed from memory with sqlite2mdoc_parse(), then
+ * post-processed once with sqlite2mdoc_postprocess(), after which its
+ * pages may be iterated over, looked up, and rendered through a
+ * caller-supplied writer.
+ * Instances are independent of each other.
+ * Memory allocation failure is fatal.
+ */
+
+/*
+ * Output types of rendered pages.
+ */
+enum	sqlite2mdoc_type {
+	SQLITE2MDOC_MDOC, /* mdoc(7) */
+	SQLITE2MDOC_HTML, /* stand-alone HTML5 */
+	SQLITE2MDOC_MARKDOWN, /* Markdown */
+	SQLITE2MDOC_JSON, /* single JSON object */
+	SQLITE2MDOC__MAX
+};
+
+/*
+ * Flags to sqlite2mdoc_parse().
+ */
+#define	SQLITE2MDOC_VERBOSE	0x01 /* warn about parse and link errors */
+
+struct	sqlite2mdoc;
+struct	sqlite2mdoc_page;
+
+/*
+ * Receives rendered output, which may be in several pieces.
+ * Returns zero on failure, which aborts rendering.
+ */
+typedef int (*sqlite2mdoc_writer)(void *, const char *, size_t);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct sqlite2mdoc *
+	 sqlite2mdoc_parse(const char *, const char *, size_t, unsigned int);
+int	 sqlite2mdoc_postprocess(struct sqlite2mdoc *, enum sqlite2mdoc_type);
+void	 sqlite2mdoc_free(struct sqlite2mdoc *);
+
+const struct sqlite2mdoc_page *
+	 sqlite2mdoc_first(const struct sqlite2mdoc *);
+const struct sqlite2mdoc_page *
+	 sqlite2mdoc_next(const struct sqlite2mdoc_page *);
+const struct sqlite2mdoc_page *
+	 sqlite2mdoc_find(const struct sqlite2mdoc *, const char *);
+
+const char *sqlite2mdoc_page_file(const struct sqlite2mdoc_page *);
+const char *sqlite2mdoc_page_name(const struct sqlite2mdoc_page *);
+size_t	 sqlite2mdoc_page_line(const struct sqlite2mdoc_page *);
+
+int	 sqlite2mdoc_render(struct sqlite2mdoc *,
+		const struct sqlite2mdoc_page *, enum sqlite2mdoc_type,
+		sqlite2mdoc_writer, void *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*!SQLITE2MDOC_H*/
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <stdio.h>
+#include <time.h>
+
+#include "extern.h"
+
+/*
+ * Statistics being collected, or NULL if not.
+ * All collection points check this first.
+ * It may only be set before anything is allocated with mem_*(), as
+ * allocations only carry their size if it's set.
+ */
+struct stats	*stats;
+
+static const char *const stages[STAGE__MAX] = {
+	"parse", /* STAGE_PARSE */
+	"postprocess", /* STAGE_POSTPROCESS */
+	"render", /* STAGE_RENDER */
+	"write", /* STAGE_WRITE */
+};
+
+static const char *const memnames[MEM__MAX] = {
+	"parse", /* MEM_PARSE */
+	"postprocess", /* MEM_POSTPROCESS */
+	"render", /* MEM_RENDER */
+};
+
+static double
+clock_secs(clockid_t id)
+{
+	struct timespec	 ts;
+
+	if (clock_gettime(id, &ts) == -1)
+		err(1, "clock_gettime");
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Mark the start of a stage.
+ * Stages don't nest: this should be followed by stats_end().
+ */
+void
+stats_begin(void)
+{
+
+	if (stats == NULL)
+		return;
+	stats->wall = clock_secs(CLOCK_MONOTONIC);
+	stats->cpu = clock_secs(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+/*
+ * Accumulate the time since stats_begin() into the given stage.
+ */
+void
+stats_end(enum stage st)
+{
+
+	if (stats == NULL)
+		return;
+	stats->stages[st].wall += clock_secs(CLOCK_MONOTONIC) - stats->wall;
+	stats->stages[st].cpu +=
+		clock_secs(CLOCK_PROCESS_CPUTIME_ID) - stats->cpu;
+}
+
+/*
+ * Count the definitions, their declarations, and description sizes.
+ * This is done once after each parse, accumulating over all of them,
+ * so it costs nothing if unused.
+ */
+void
+stats_parse(const struct parse *p)
+{
+	const struct defn	*d;
+
+	if (stats == NULL)
+		return;
+	stats->lines += p->ln;
+	stats->defns += p->defsz;
+	for (d = p->defs; d < p->defs + p->defsz; d++) {
+		stats->descsz += d->descsz;
+		stats->decls += d->declsz;
+	}
+}
+
+/*
+ * Print the statistics to "f" either as text or as a JSON object.
+ */
+void
+stats_print(FILE *f, int json)
+{
+	size_t	 i;
+	double	 wall = 0.0, cpu = 0.0;
+
+	if (stats == NULL)
+		return;
+
+	if (json) {
+		fputs("{\"stages\":{", f);
+		for (i = 0; i < STAGE__MAX; i++)
+			fprintf(f, "%s\"%s\":{\"wall\":%.6f,\"cpu\":%.6f}",
+				i > 0 ? "," : "", stages[i],
+				stats->stages[i].wall, stats->stages[i].cpu);
+		fprintf(f, "},\"lines\":%zu,\"defns\":%zu,"
+			"\"decls\":%zu,\"descbytes\":%zu,"
+			"\"hashinserts\":%zu,\"hashlookups\":%zu,"
+			"\"hashmisses\":%zu,\"pages\":%zu,"
+			"\"bytes\":%zu,\"memory\":{",
+			stats->lines, stats->defns, stats->decls,
+			stats->descsz, stats->hinserts, stats->hlookups,
+			stats->hmisses, stats->pages, stats->outsz);
+		for (i = 0; i < MEM__MAX; i++)
+			fprintf(f, "%s\"%s\":{\"allocs\":%zu,"
+				"\"reallocs\":%zu,\"frees\":%zu,"
+				"\"live\":%zu,\"peak\":%zu}",
+				i > 0 ? "," : "", memnames[i],
+				stats->mem[i].allocs, stats->mem[i].reallocs,
+				stats->mem[i].frees, stats->mem[i].live,
+				stats->mem[i].peak);
+		fputs("}}\n", f);
+		return;
+	}
+
+	fprintf(f, "%-16s %10s %10s\n", "stage", "wall (s)", "cpu (s)");
+	for (i = 0; i < STAGE__MAX; i++) {
+		fprintf(f, "%-16s %10.6f %10.6f\n", stages[i],
+			stats->stages[i].wall, stats->stages[i].cpu);
+		wall += stats->stages[i].wall;
+		cpu += stats->stages[i].cpu;
+	}
+	fprintf(f, "%-16s %10.6f %10.6f\n", "total", wall, cpu);
+	fprintf(f, "%-16s %10zu\n", "lines", stats->lines);
+	fprintf(f, "%-16s %10zu\n", "defns", stats->defns);
+	fprintf(f, "%-16s %10zu\n", "decls", stats->decls);
+	fprintf(f, "%-16s %10zu\n", "desc bytes", stats->descsz);
+	fprintf(f, "%-16s %10zu\n", "hash inserts", stats->hinserts);
+	fprintf(f, "%-16s %10zu\n", "hash lookups", stats->hlookups);
+	fprintf(f, "%-16s %10zu\n", "hash misses", stats->hmisses);
+	fprintf(f, "%-16s %10zu\n", "pages", stats->pages);
+	fprintf(f, "%-16s %10zu\n", "bytes written", stats->outsz);
+	fprintf(f, "%-16s %10s %10s %10s %10s %10s\n", "memory",
+		"allocs", "reallocs", "frees", "live", "peak");
+	for (i = 0; i < MEM__MAX; i++)
+		fprintf(f, "%-16s %10zu %10zu %10zu %10zu %10zu\n",
+			memnames[i], stats->mem[i].allocs,
+			stats->mem[i].reallocs, stats->mem[i].frees,
+			stats->mem[i].live, stats->mem[i].peak);
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+
+#include "extern.h"
+
+/*
+ * The string table stores each distinct string once, so that the
+ * names, keywords, and references of a parse (the same identifiers
+ * appear many times over) may be compared by pointer.
+ * Strings are packed into chunks instead of allocated one by one.
+ * Like the keyword table, it's open-addressed with linear probing, but
+ * it's kept at most three-quarters full as it's only used for adding.
+ */
+
+#define	STRTAB_MINSZ	256 /* initial slots (power of two) */
+#define	STRTAB_CHUNKSZ	8192 /* bytes per chunk */
+
+/*
+ * FNV-1a, as for the keyword table, but of a string of known length.
+ */
+static unsigned int
+strtab_hash(const char *cp, size_t sz)
+{
+	unsigned int	 h = 2166136261U;
+	size_t		 i;
+
+	for (i = 0; i < sz; i++) {
+		h ^= (unsigned char)cp[i];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static void
+strtab_grow(struct strtab *t)
+{
+	struct strent	*ents;
+	size_t		 i, j, sz;
+
+	sz = t->sz == 0 ? STRTAB_MINSZ : t->sz * 2;
+	if ((ents = mem_calloc(MEM_POSTPROCESS,
+	    sz, sizeof(struct strent))) == NULL)
+		err(1, NULL);
+
+	for (i = 0; i < t->sz; i++) {
+		if (t->ents[i].str == NULL)
+			continue;
+		j = t->ents[i].hash & (sz - 1);
+		while (ents[j].str != NULL)
+			j = (j + 1) & (sz - 1);
+		ents[j] = t->ents[i];
+	}
+
+	mem_free(t->ents);
+	t->ents = ents;
+	t->sz = sz;
+}
+
+/*
+ * Copy "sz" bytes of "cp" with a NUL terminator into a chunk.
+ * Strings too long for a chunk get their own.
+ */
+static char *
+strtab_copy(struct strtab *t, const char *cp, size_t sz)
+{
+	char	*str;
+	void	*pp;
+	size_t	 chunksz;
+
+	if (sz + 1 > t->left) {
+		chunksz = sz + 1 > STRTAB_CHUNKSZ ? sz + 1 : STRTAB_CHUNKSZ;
+		pp = mem_reallocarray(MEM_POSTPROCESS, t->chunks,
+			t->chunksz + 1, sizeof(char *));
+		if (pp == NULL)
+			err(1, NULL);
+		t->chunks = pp;
+		if ((t->next = mem_malloc(MEM_POSTPROCESS, chunksz)) == NULL)
+			err(1, NULL);
+		t->chunks[t->chunksz++] = t->next;
+		t->left = chunksz;
+	}
+
+	str = t->next;
+	memcpy(str, cp, sz);
+	str[sz] = '\0';
+	t->next += sz + 1;
+	t->left -= sz + 1;
+	return str;
+}
+
+/*
+ * Return the table's copy of the "sz" bytes at "cp", adding it if not
+ * already there.
+ * The copy is NUL-terminated and lives until strtab_free().
+ */
+const char *
+strtab_intern(struct strtab *t, const char *cp, size_t sz)
+{
+	unsigned int	 h;
+	size_t		 i;
+
+	if ((t->len + 1) * 4 > t->sz * 3)
+		strtab_grow(t);
+
+	h = strtab_hash(cp, sz);
+	for (i = h & (t->sz - 1); t->ents[i].str != NULL;
+	     i = (i + 1) & (t->sz - 1))
+		if (t->ents[i].hash == h &&
+		    strncmp(t->ents[i].str, cp, sz) == 0 &&
+		    t->ents[i].str[sz] == '\0')
+			return t->ents[i].str;
+
+	t->ents[i].str = strtab_copy(t, cp, sz);
+	t->ents[i].hash = h;
+	t->len++;
+	return t->ents[i].str;
+}
+
+/*
+ * Free the table and all of its strings, leaving it empty and reusable.
+ */
+void
+strtab_free(struct strtab *t)
+{
+	size_t	 i;
+
+	for (i = 0; i < t->chunksz; i++)
+		mem_free(t->chunks[i]);
+	mem_free(t->chunks);
+	mem_free(t->ents);
+	memset(t, 0, sizeof(struct strtab));
+}
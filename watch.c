@@ -0,0 +1,473 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#include <sys/stat.h>
+#if defined(__linux__)
+# include <sys/inotify.h>
+#endif
+
+#include <ctype.h>
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "extern.h"
+
+/*
+ * Watch mode keeps the input split into blocks, each starting at a
+ * CAPI3REF line and parsed on its own.
+ * When the input changes, only blocks whose text differs are parsed
+ * and post-processed again, and only their pages and those referring
+ * to their keywords are emitted.
+ */
+
+/*
+ * A block of the input and its definitions.
+ */
+struct	wblock {
+	char		*text; /* contents (NUL-terminated) */
+	size_t		 sz; /* strlen(text) */
+	unsigned int	 hash; /* hash of text */
+	size_t		 ln; /* line of first line, from 1 */
+	int		 fresh; /* parsed in this update */
+	struct parse	 p; /* parse of the block */
+};
+
+/*
+ * A block's extent within the input before it's copied.
+ */
+struct	wrange {
+	const char	*cp;
+	size_t		 sz;
+	size_t		 ln;
+};
+
+static unsigned int
+watch_hash(const char *cp, size_t sz)
+{
+	unsigned int	 h = 2166136261U;
+	size_t		 i;
+
+	for (i = 0; i < sz; i++) {
+		h ^= (unsigned char)cp[i];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/*
+ * Whether the "sz" bytes at "cp" are a line beginning a definition, as
+ * init() in the parser recognises.
+ */
+static int
+watch_isblock(const char *cp, size_t sz)
+{
+
+	if (sz < 2 || cp[0] != '*' || cp[1] != '*')
+		return 0;
+	for (cp += 2, sz -= 2; sz > 0 && isspace((unsigned char)*cp); sz--)
+		cp++;
+	return sz >= 9 && strncmp(cp, "CAPI3REF:", 9) == 0;
+}
+
+/*
+ * Split the input into blocks.
+ * Anything before the first block is its own block, although it never
+ * has definitions.
+ */
+static size_t
+watch_split(const char *buf, size_t sz, struct wrange **res)
+{
+	const char	*cp, *end, *start;
+	size_t		 n = 0, ln, startln;
+
+	*res = NULL;
+	start = buf;
+	startln = 1;
+
+	for (cp = buf, ln = 1; cp < buf + sz; cp = end + 1, ln++) {
+		if ((end = memchr(cp, '\n', buf + sz - cp)) == NULL)
+			end = buf + sz;
+		if (cp == start || !watch_isblock(cp, end - cp))
+			continue;
+		*res = mem_reallocarray(MEM_PARSE,
+			*res, n + 1, sizeof(struct wrange));
+		if (*res == NULL)
+			err(1, NULL);
+		(*res)[n].cp = start;
+		(*res)[n].sz = cp - start;
+		(*res)[n].ln = startln;
+		n++;
+		start = cp;
+		startln = ln;
+	}
+
+	if (start < buf + sz) {
+		*res = mem_reallocarray(MEM_PARSE,
+			*res, n + 1, sizeof(struct wrange));
+		if (*res == NULL)
+			err(1, NULL);
+		(*res)[n].cp = start;
+		(*res)[n].sz = buf + sz - start;
+		(*res)[n].ln = startln;
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * Parse a block from scratch.
+ * Its definitions are then moved onto the shared keyword table and
+ * post-processed.
+ */
+static void
+watch_parse(struct watch *w, struct wblock *b)
+{
+	char		*cp, *end;
+	struct defn	*d;
+
+	parse_init(&b->p, w->fn);
+	b->p.verbose = w->verbose;
+	b->p.filter = w->filter;
+	b->p.ln = b->ln - 1;
+
+	for (cp = b->text; *cp != '\0'; cp = end + 1) {
+		b->p.ln++;
+		if ((end = strchr(cp, '\n')) == NULL) {
+			parse_line(&b->p, cp, strlen(cp));
+			break;
+		}
+		*end = '\0';
+		parse_line(&b->p, cp, end - cp);
+		*end = '\n';
+	}
+
+	(void)parse_finish(&b->p);
+
+	for (d = b->p.defs; d < b->p.defs + b->p.defsz; d++) {
+		d->keytab = &w->keys;
+		parse_postprocess(d, w->suffix);
+	}
+}
+
+static void
+watch_block_free(struct wblock *b)
+{
+
+	parse_free(&b->p);
+	mem_free(b->text);
+}
+
+/*
+ * Enter all keywords and names of the definitions of "b" into "t".
+ */
+static void
+watch_keys(struct keytab *t, const struct wblock *b)
+{
+	const struct defn	*d;
+	size_t			 i;
+
+	for (d = b->p.defs; d < b->p.defs + b->p.defsz; d++) {
+		for (i = 0; i < d->keysz; i++)
+			keytab_insert(t, d->keys[i], d);
+		for (i = 0; i < d->nmsz; i++)
+			keytab_insert(t, d->nms[i], d);
+	}
+}
+
+/*
+ * Whether "d" refers to any keyword in "t".
+ * Its references include both those of SEE ALSO and the links within
+ * its description.
+ */
+static int
+watch_refers(const struct defn *d, const struct keytab *t)
+{
+	size_t	 i;
+
+	for (i = 0; i < d->xrsz; i++)
+		if (keytab_find(t, d->xrs[i]) != NULL)
+			return 1;
+	return 0;
+}
+
+void
+watch_init(struct watch *w, const char *fn, const char *suffix,
+	int verbose)
+{
+
+	memset(w, 0, sizeof(struct watch));
+	w->fn = fn;
+	w->suffix = suffix;
+	w->verbose = verbose;
+	w->fd = -1;
+}
+
+void
+watch_free(struct watch *w)
+{
+	size_t	 i;
+
+	for (i = 0; i < w->bsz; i++)
+		watch_block_free(&w->bs[i]);
+	mem_free(w->bs);
+	keytab_free(&w->keys);
+	if (w->fd != -1)
+		close(w->fd);
+}
+
+/*
+ * Bring the model up to date with the input "buf".
+ * Pages that are new or may have changed are passed to "emit"; files
+ * of pages that no longer exist are passed to "remove".
+ * Returns the number of pages emitted.
+ */
+size_t
+watch_update(struct watch *w, const char *buf, size_t sz,
+	void (*emit)(const struct defn *), void (*remove)(const char *))
+{
+	struct wrange	*rs;
+	struct wblock	*bs, *ob;
+	struct keytab	 touched, fnames;
+	struct defn	*d;
+	size_t		 i, j, k = 0, n, rsz, emitted = 0;
+	unsigned int	 h;
+	int		 moved;
+
+	memset(&touched, 0, sizeof(struct keytab));
+	memset(&fnames, 0, sizeof(struct keytab));
+
+	rsz = watch_split(buf, sz, &rs);
+	if ((bs = mem_calloc(MEM_PARSE, rsz, sizeof(struct wblock))) == NULL)
+		err(1, NULL);
+
+	/*
+	 * Match each new block with an unclaimed old one of the same
+	 * text, looking first where we'd expect it to be.
+	 * Unmatched blocks are copied and parsed.
+	 */
+
+	for (i = j = 0; i < rsz; i++) {
+		h = watch_hash(rs[i].cp, rs[i].sz);
+		for (n = 0; n < w->bsz; n++) {
+			k = (j + n) % w->bsz;
+			ob = &w->bs[k];
+			if (ob->text != NULL && ob->hash == h &&
+			    ob->sz == rs[i].sz &&
+			    memcmp(ob->text, rs[i].cp, rs[i].sz) == 0)
+				break;
+		}
+		if (n < w->bsz) {
+			j = (k + 1) % w->bsz;
+			bs[i].text = ob->text;
+			bs[i].sz = ob->sz;
+			bs[i].hash = ob->hash;
+			parse_move(&bs[i].p, &ob->p);
+			ob->text = NULL;
+			moved = ob->ln != rs[i].ln;
+			for (d = bs[i].p.defs;
+			     d < bs[i].p.defs + bs[i].p.defsz; d++)
+				d->ln = d->ln + rs[i].ln - ob->ln;
+			bs[i].ln = rs[i].ln;
+			bs[i].fresh = moved;
+			continue;
+		}
+		bs[i].text = mem_strndup(MEM_PARSE, rs[i].cp, rs[i].sz);
+		if (bs[i].text == NULL)
+			err(1, NULL);
+		bs[i].sz = rs[i].sz;
+		bs[i].hash = h;
+		bs[i].ln = rs[i].ln;
+		bs[i].fresh = 1;
+		watch_parse(w, &bs[i]);
+		watch_keys(&touched, &bs[i]);
+	}
+	mem_free(rs);
+
+	/* Keywords of removed blocks are also touched. */
+
+	for (i = 0; i < w->bsz; i++)
+		if (w->bs[i].text != NULL)
+			watch_keys(&touched, &w->bs[i]);
+
+	/*
+	 * Rebuild the keyword table in input order, so that the first
+	 * definition of a keyword wins as in a full parse.
+	 * This is cheap compared to parsing and rendering.
+	 */
+
+	keytab_free(&w->keys);
+	for (i = 0; i < rsz; i++)
+		watch_keys(&w->keys, &bs[i]);
+
+	/*
+	 * Emit new and moved pages and those referring to any touched
+	 * keyword, whose targets may have changed.
+	 */
+
+	for (i = 0; i < rsz; i++)
+		for (d = bs[i].p.defs;
+		     d < bs[i].p.defs + bs[i].p.defsz; d++) {
+			if (d->fname != NULL)
+				keytab_insert(&fnames, d->fname, d);
+			if (bs[i].fresh || watch_refers(d, &touched)) {
+				emit(d);
+				emitted++;
+			}
+		}
+
+	/* Remove files no longer produced. */
+
+	for (i = 0; i < w->bsz; i++) {
+		if (w->bs[i].text == NULL)
+			continue;
+		for (d = w->bs[i].p.defs;
+		     d < w->bs[i].p.defs + w->bs[i].p.defsz; d++)
+			if (d->fname != NULL &&
+			    keytab_find(&fnames, d->fname) == NULL)
+				remove(d->fname);
+	}
+
+	keytab_free(&touched);
+	keytab_free(&fnames);
+
+	for (i = 0; i < w->bsz; i++)
+		if (w->bs[i].text != NULL)
+			watch_block_free(&w->bs[i]);
+	mem_free(w->bs);
+	w->bs = bs;
+	w->bsz = rsz;
+	return emitted;
+}
+
+#if !defined(__linux__)
+/*
+ * Note the input's modification time, size and inode.
+ * Returns zero if it can't be had.
+ */
+static int
+watch_stat(struct watch *w)
+{
+	struct stat	 st;
+
+	if (stat(w->fn, &st) == -1)
+		return 0;
+	w->mtime = st.st_mtime;
+	w->size = st.st_size;
+	w->ino = st.st_ino;
+	return 1;
+}
+#endif
+
+/*
+ * Start watching the input file, which must be done before it's first
+ * read so that no change is missed between reading and waiting.
+ * On Linux, this uses inotify(7) on the file's directory, as editors
+ * often replace files instead of writing them.
+ * Otherwise, it notes the file's modification time, size, and inode,
+ * which are then polled.
+ * Returns zero on failure.
+ */
+int
+watch_start(struct watch *w)
+{
+#if defined(__linux__)
+	char		 dir[PATH_MAX];
+
+	if (strlcpy(dir, w->fn, sizeof(dir)) >= sizeof(dir)) {
+		warnx("%s: name too long", w->fn);
+		return 0;
+	}
+	if ((w->fd = inotify_init()) == -1) {
+		warn("inotify_init");
+		return 0;
+	}
+	if (inotify_add_watch(w->fd, dirname(dir),
+	    IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+		warn("%s: inotify_add_watch", dir);
+		return 0;
+	}
+	return 1;
+#else
+	if (!watch_stat(w)) {
+		warn("%s", w->fn);
+		return 0;
+	}
+	return 1;
+#endif
+}
+
+/*
+ * Wait until the input file has been written or replaced since
+ * watch_start() or the last call.
+ * Returns zero on failure, non-zero when the file has changed.
+ */
+int
+watch_wait(struct watch *w)
+{
+#if defined(__linux__)
+	char		 ev[sizeof(struct inotify_event) + NAME_MAX + 1]
+			    __attribute__((aligned(8)));
+	const struct inotify_event *ie;
+	const char	*cp;
+	ssize_t		 ssz;
+	size_t		 off;
+
+	if ((cp = strrchr(w->fn, '/')) != NULL)
+		cp++;
+	else
+		cp = w->fn;
+
+	for (;;) {
+		if ((ssz = read(w->fd, ev, sizeof(ev))) == -1) {
+			if (errno == EINTR)
+				continue;
+			warn("inotify");
+			return 0;
+		}
+		for (off = 0; off < (size_t)ssz;
+		     off += sizeof(struct inotify_event) + ie->len) {
+			ie = (const struct inotify_event *)(ev + off);
+			if (ie->len > 0 && strcmp(ie->name, cp) == 0)
+				return 1;
+		}
+	}
+#else
+	long long		 mtime = w->mtime, size = w->size;
+	unsigned long long	 ino = w->ino;
+
+	for (;;) {
+		sleep(1);
+		if (!watch_stat(w))
+			continue;
+		if (w->mtime != mtime || w->size != size ||
+		    w->ino != ino)
+			return 1;
+	}
+#endif
+}
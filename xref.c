@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) Kristaps Dzonsons <kristaps@bsd.lv>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHORS DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include "config.h"
+
+#if HAVE_SYS_QUEUE
+# include <sys/queue.h>
+#endif
+#include <assert.h>
+#include <ctype.h>
+#if HAVE_ERR
+# include <err.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extern.h"
+
+/*
+ * Most keywords suggested for a reference that isn't found.
+ */
+#define	XREF_SUGGEST	3
+
+/*
+ * Convenience function to look up which manpage "hosts" a certain
+ * keyword.  For example, SQLITE_OK(3) also handles SQLITE_TOOBIG and so
+ * on, so a reference to SQLITE_TOOBIG should actually point to
+ * SQLITE_OK.
+ * Returns the keyword's definition if found or NULL.
+ */
+const struct defn *
+xref_lookup(const struct keytab *t, const char *key)
+{
+	const struct defn	*d;
+
+	if (stats != NULL)
+		stats->hlookups++;
+	if ((d = keytab_find(t, key)) == NULL) {
+		if (stats != NULL)
+			stats->hmisses++;
+		return NULL;
+	}
+
+	if (d->nmsz == 0)
+		return NULL;
+
+	assert(d->nms[0] != NULL);
+	return d;
+}
+
+/*
+ * Warn that "key" referenced by "d" isn't known, suggesting the most
+ * similar keywords that are.
+ */
+static void
+xref_missing(const struct defn *d, const char *key)
+{
+	const char	*sugs[XREF_SUGGEST];
+	struct buf	 b;
+	size_t		 i, sugsz;
+
+	sugsz = keytab_suggest(d->keytab, key, sugs, XREF_SUGGEST);
+	if (sugsz == 0) {
+		warnx("%s:%zu: ref not found: %s", d->fn, d->ln, key);
+		return;
+	}
+	memset(&b, 0, sizeof(struct buf));
+	for (i = 0; i < sugsz; i++)
+		buf_printf(&b, "%s%s", i > 0 ? ", " : "", sugs[i]);
+	warnx("%s:%zu: ref not found: %s (did you mean %s?)",
+		d->fn, d->ln, key, b.data);
+	buf_free(&b);
+}
+
+/*
+ * Order pages by name, case-insensitively, then by case.
+ */
+static int
+namecmp(const struct defn *d1, const struct defn *d2)
+{
+	int	 rc;
+
+	if ((rc = strcasecmp(d1->nms[0], d2->nms[0])) == 0)
+		rc = strcmp(d1->nms[0], d2->nms[0]);
+	return rc;
+}
+
+static int
+ordcmp(const void *p1, const void *p2)
+{
+
+	return namecmp(*(const struct defn **)p1,
+		*(const struct defn **)p2);
+}
+
+/*
+ * Like namecmp(), but using the order assigned by xref_order() if both
+ * have one.
+ */
+static int
+xrcmp(const void *p1, const void *p2)
+{
+	const struct defn *d1 = *(const struct defn **)p1,
+			  *d2 = *(const struct defn **)p2;
+
+	if (d1->ord != 0 && d2->ord != 0)
+		return d1->ord < d2->ord ? -1 : d1->ord > d2->ord;
+	return namecmp(d1, d2);
+}
+
+/*
+ * Number the pages "defs" in the order of their names with one sort,
+ * so that sorting references needn't compare names.
+ * This includes pages left out by a filter, as they may still be the
+ * targets of references.
+ * Must follow post-processing.
+ */
+void
+xref_order(struct defn *defs, size_t defsz)
+{
+	struct defn	**ds;
+	struct defn	 *d;
+	size_t		  i, sz = 0;
+
+	for (d = defs; d < defs + defsz; d++) {
+		d->ord = 0;
+		if (d->nmsz > 0)
+			sz++;
+	}
+	if (sz == 0)
+		return;
+	if ((ds = mem_calloc(MEM_POSTPROCESS,
+	    sz, sizeof(struct defn *))) == NULL)
+		err(1, NULL);
+	sz = 0;
+	for (d = defs; d < defs + defsz; d++)
+		if (d->nmsz > 0)
+			ds[sz++] = d;
+	qsort(ds, sz, sizeof(struct defn *), ordcmp);
+	for (i = 0; i < sz; i++)
+		ds[i]->ord = i + 1;
+	mem_free(ds);
+}
+
+/*
+ * Look up all of our keywords (which are in the xrs field) in the table
+ * of all known keywords, sorting them by the name of the manpage they
+ * resolve to.
+ * Don't include duplicates, unresolved references, or references to
+ * ourselves.
+ * Returns the number of manpages filled into "res", which is scratch of
+ * the render buffer "b" and valid until it's next used for this.
+ * The scratch only ever grows, so once it fits the page with the most
+ * references, this doesn't allocate.
+ */
+size_t
+xref_resolve(struct buf *b, const struct defn *d, int verbose,
+	const struct defn ***res)
+{
+	size_t			  i, j, sz = 0;
+	const struct defn	 *xd;
+	void			 *pp;
+
+	if (d->xrsz > b->xrmax) {
+		pp = mem_reallocarray(MEM_RENDER,
+			b->xrs, d->xrsz, sizeof(struct defn *));
+		if (pp == NULL)
+			err(1, NULL);
+		b->xrs = pp;
+		b->xrmax = d->xrsz;
+	}
+	if ((*res = b->xrs) == NULL)
+		return 0;
+
+	for (i = 0; i < d->xrsz; i++) {
+		xd = xref_lookup(d->keytab, d->xrs[i]);
+
+		/* Ignore self-reference. */
+
+		if (xd == d && verbose)
+			warnx("%s:%zu: self-reference: %s",
+				d->fn, d->ln, d->xrs[i]);
+		if (xd == d)
+			continue;
+		if (xd == NULL && verbose)
+			xref_missing(d, d->xrs[i]);
+		if (xd == NULL)
+			continue;
+		(*res)[sz++] = xd;
+	}
+
+	qsort(*res, sz, sizeof(struct defn *), xrcmp);
+
+	/* Ignore duplicates. */
+
+	for (i = j = 0; i < sz; i++)
+		if (j == 0 || (*res)[j - 1] != (*res)[i])
+			(*res)[j++] = (*res)[i];
+
+	return j;
+}
+
+/*
+ * Split the in-text reference, "[key]" or "[key|text]", at the opening
+ * bracket "i" of the description of "d" into the text to show (into
+ * "txt" and "txtsz") and the page it refers to (into "xd"), which is
+ * NULL if unknown or "d" itself.
+ * Keys are normalised as when collecting references; "fn" is set if the
+ * key names a function and is also the text.
+ * Returns the position after the closing bracket or zero if there is
+ * none, in which case the bracket is only text.
+ */
+size_t
+xref_token(struct buf *b, const struct defn *d, size_t i,
+	const char **txt, size_t *txtsz, int *fn, const struct defn **xd)
+{
+	const char	*key;
+	struct buf	*tmp;
+	size_t		 keysz, end;
+
+	key = &d->desc[++i];
+	for (end = i; end < d->descsz; end++)
+		if (d->desc[end] == '|' || d->desc[end] == ']')
+			break;
+	if (end == d->descsz)
+		return 0;
+	keysz = end - i;
+
+	if (d->desc[end] == '|') {
+		*txt = &d->desc[++end];
+		while (isspace((unsigned char)**txt))
+			(*txt)++;
+		while (end < d->descsz && d->desc[end] != ']')
+			end++;
+		if (end == d->descsz)
+			return 0;
+		*txtsz = &d->desc[end] - *txt;
+	} else {
+		*txt = key;
+		*txtsz = keysz;
+	}
+
+	*fn = 0;
+	while (keysz > 1 && key[keysz - 1] == ' ')
+		keysz--;
+	if (keysz > 2 && key[keysz - 2] == '(' && key[keysz - 1] == ')') {
+		keysz -= 2;
+		*fn = *txt == key;
+	}
+
+	tmp = buf_scratch(b);
+	buf_write(tmp, key, keysz);
+	if ((*xd = xref_lookup(d->keytab, tmp->data)) == d)
+		*xd = NULL;
+	return end + 1;
+}
+
+/*
+ * Fill in the pages referring to each page of "defs", sorted like
+ * references are, with one pass over all references to count them and
+ * another to fill them in.
+ * Duplicate references and self-references are ignored as they are by
+ * xref_resolve().
+ */
+void
+xref_invert(struct defn *defs, size_t defsz)
+{
+	struct defn	*d, *xd;
+	size_t		 i;
+
+	/*
+	 * Definitions in the keyword table are those of "defs", so it's
+	 * safe to modify what lookups return.
+	 * First, drop any previous inversion, then count an upper bound
+	 * of referring pages.
+	 */
+
+	for (d = defs; d < defs + defsz; d++) {
+		mem_free(d->rxs);
+		d->rxs = NULL;
+		d->rxsz = 0;
+	}
+
+	for (d = defs; d < defs + defsz; d++)
+		for (i = 0; i < d->xrsz; i++) {
+			xd = (struct defn *)xref_lookup(d->keytab, d->xrs[i]);
+			if (xd != NULL && xd != d)
+				xd->rxsz++;
+		}
+
+	for (d = defs; d < defs + defsz; d++) {
+		if (d->rxsz == 0)
+			continue;
+		d->rxs = mem_calloc(MEM_POSTPROCESS,
+			d->rxsz, sizeof(struct defn *));
+		if (d->rxs == NULL)
+			err(1, NULL);
+		d->rxsz = 0;
+	}
+
+	/* Pages are visited once, so duplicates are always the last. */
+
+	for (d = defs; d < defs + defsz; d++)
+		for (i = 0; i < d->xrsz; i++) {
+			xd = (struct defn *)xref_lookup(d->keytab, d->xrs[i]);
+			if (xd == NULL || xd == d)
+				continue;
+			if (xd->rxsz > 0 && xd->rxs[xd->rxsz - 1] == d)
+				continue;
+			xd->rxs[xd->rxsz++] = d;
+		}
+
+	for (d = defs; d < defs + defsz; d++)
+		if (d->rxsz > 1)
+			qsort(d->rxs, d->rxsz,
+				sizeof(struct defn *), xrcmp);
+}